@@ -0,0 +1,129 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+
+#include "Crc32c.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+namespace PhilipsHue {
+
+const std::array<uint32_t, 256> Crc32c::_table = Crc32c::createTable();
+const bool Crc32c::_hardwareSupport = Crc32c::hasHardwareSupport();
+
+std::array<uint32_t, 256> Crc32c::createTable() {
+  std::array<uint32_t, 256> table{};
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t crc = i;
+    for (int32_t j = 0; j < 8; j++) {
+      crc = (crc & 1) ? (crc >> 1) ^ 0x82F63B78 : crc >> 1;
+    }
+    table[i] = crc;
+  }
+  return table;
+}
+
+bool Crc32c::hasHardwareSupport() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __builtin_cpu_supports("sse4.2");
+#elif defined(__ARM_FEATURE_CRC32)
+  return true;
+#else
+  return false;
+#endif
+}
+
+uint32_t Crc32c::calculate(const std::string &data) {
+  return calculate(data.data(), data.size());
+}
+
+uint32_t Crc32c::calculate(const char *data, size_t size) {
+  return _hardwareSupport ? calculateHardware(data, size) : calculateSoftware(data, size);
+}
+
+uint32_t Crc32c::calculateSoftware(const char *data, size_t size) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < size; i++) {
+    crc = _table[(crc ^ (uint8_t)data[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2"))) uint32_t Crc32c::calculateHardware(const char *data, size_t size) {
+  uint64_t crc = 0xFFFFFFFF;
+  uint64_t block = 0;
+  for (; size >= 8; size -= 8, data += 8) {
+    std::memcpy(&block, data, 8);
+    crc = _mm_crc32_u64(crc, block);
+  }
+  for (; size > 0; size--, data++) {
+    crc = _mm_crc32_u8((uint32_t)crc, (uint8_t)*data);
+  }
+  return ~(uint32_t)crc;
+}
+#elif defined(__i386__)
+__attribute__((target("sse4.2"))) uint32_t Crc32c::calculateHardware(const char *data, size_t size) {
+  uint32_t crc = 0xFFFFFFFF;
+  uint32_t block = 0;
+  for (; size >= 4; size -= 4, data += 4) {
+    std::memcpy(&block, data, 4);
+    crc = _mm_crc32_u32(crc, block);
+  }
+  for (; size > 0; size--, data++) {
+    crc = _mm_crc32_u8(crc, (uint8_t)*data);
+  }
+  return ~crc;
+}
+#elif defined(__ARM_FEATURE_CRC32)
+uint32_t Crc32c::calculateHardware(const char *data, size_t size) {
+  uint32_t crc = 0xFFFFFFFF;
+  uint32_t block = 0;
+  for (; size >= 4; size -= 4, data += 4) {
+    std::memcpy(&block, data, 4);
+    crc = __crc32cw(crc, block);
+  }
+  for (; size > 0; size--, data++) {
+    crc = __crc32cb(crc, (uint8_t)*data);
+  }
+  return ~crc;
+}
+#else
+uint32_t Crc32c::calculateHardware(const char *data, size_t size) {
+  return calculateSoftware(data, size);
+}
+#endif
+
+}
@@ -27,55 +27,35 @@
  * files in the program, then also delete it here.
  */
 
-#ifndef PACKETMANAGER_H_
-#define PACKETMANAGER_H_
 
-#include <homegear-base/BaseLib.h>
-#include "PhilipsHuePacket.h"
+#ifndef CRC32C_H_
+#define CRC32C_H_
 
-#include <iostream>
+#include <array>
+#include <cstdint>
 #include <string>
-#include <chrono>
-#include <memory>
-#include <unordered_map>
-#include <thread>
-#include <mutex>
 
-namespace PhilipsHue
-{
-class PhilipsHuePacketInfo
-{
-public:
-	PhilipsHuePacketInfo();
-	virtual ~PhilipsHuePacketInfo() {}
+namespace PhilipsHue {
 
-	uint32_t id = 0;
-	int64_t time;
-	std::shared_ptr<PhilipsHuePacket> packet;
-};
-
-class PacketManager
-{
-public:
-	PacketManager();
-	virtual ~PacketManager();
-
-	std::shared_ptr<PhilipsHuePacket> get(int32_t address);
-	std::shared_ptr<PhilipsHuePacketInfo> getInfo(int32_t address);
-	bool set(int32_t address, std::shared_ptr<PhilipsHuePacket>& packet, int64_t time = 0);
-	void deletePacket(int32_t address, uint32_t id);
-	void keepAlive(int32_t address);
-	void dispose(bool wait = true);
-protected:
-	std::atomic_bool _disposing;
-	std::atomic_bool _stopWorkerThread;
-    std::thread _workerThread;
-	uint32_t _id = 0;
-	std::unordered_map<int32_t, std::shared_ptr<PhilipsHuePacketInfo>> _packets;
-	std::mutex _packetMutex;
-
-	void worker();
+/**
+ * Calculates CRC32C (Castagnoli) checksums. The checksum is calculated with the CRC32 instructions of the CPU when available (SSE 4.2 on x86, CRC extension on ARMv8) and falls back to a table based implementation otherwise.
+ */
+class Crc32c {
+ public:
+  Crc32c() = delete;
+
+  static uint32_t calculate(const std::string &data);
+  static uint32_t calculate(const char *data, size_t size);
+ private:
+  static const std::array<uint32_t, 256> _table;
+  static const bool _hardwareSupport;
+
+  static std::array<uint32_t, 256> createTable();
+  static bool hasHardwareSupport();
+  static uint32_t calculateSoftware(const char *data, size_t size);
+  static uint32_t calculateHardware(const char *data, size_t size);
 };
 
 }
+
 #endif
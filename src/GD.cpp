@@ -35,4 +35,6 @@ namespace PhilipsHue
 	PhilipsHue* GD::family = nullptr;
 	BaseLib::Output GD::out;
 	std::shared_ptr<Interfaces> GD::interfaces;
+	std::unique_ptr<Scheduler> GD::scheduler;
+	std::unique_ptr<PersistenceQueue> GD::persistenceQueue;
 }
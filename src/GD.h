@@ -32,10 +32,14 @@
 
 #define HUE_FAMILY_ID 5
 #define HUE_FAMILY_NAME "Philips hue"
+#define HUE_SENSOR_ADDRESS_OFFSET 0x80000 //Added to the bridge ID of sensors, because lights and sensors have separate ID ranges
+#define HUE_BATCH_END_MESSAGE_TYPE 0xFE //Message type of the packet raised after the packets of one poll cycle (see PhilipsHueCentral::onPacketReceived)
 
 #include <homegear-base/BaseLib.h>
 #include "PhilipsHue.h"
 #include "Interfaces.h"
+#include "Scheduler.h"
+#include "PersistenceQueue.h"
 
 using namespace BaseLib;
 using namespace BaseLib::DeviceDescription;
@@ -52,6 +56,8 @@ public:
 	static PhilipsHue* family;
 	static BaseLib::Output out;
 	static std::shared_ptr<Interfaces> interfaces;
+	static std::unique_ptr<Scheduler> scheduler;
+	static std::unique_ptr<PersistenceQueue> persistenceQueue;
 private:
 	GD();
 };
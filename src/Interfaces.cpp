@@ -30,6 +30,7 @@
 #include "Interfaces.h"
 #include "GD.h"
 #include "PhysicalInterfaces/HueBridge.h"
+#include "PhysicalInterfaces/SimulatedHueBridge.h"
 
 namespace PhilipsHue
 {
@@ -191,7 +192,7 @@ std::shared_ptr<IPhilipsHueInterface> Interfaces::addInterface(Systems::PPhysica
 		if(!settings || settings->type.empty()) return device;
 		GD::out.printDebug("Debug: Creating physical device. Type defined in philipshue.conf is: " + settings->type);
 
-		if(settings->type == "huebridge" || settings->type == "huebridge-auto")
+		if(settings->type == "huebridge" || settings->type == "huebridge-auto" || settings->type == "huebridge-sim")
 		{
 			if(_usedAddresses.find(settings->address) != _usedAddresses.end())
 			{
@@ -199,7 +200,8 @@ std::shared_ptr<IPhilipsHueInterface> Interfaces::addInterface(Systems::PPhysica
 				return device;
 			}
 			_usedAddresses.insert(settings->address);
-			device.reset(new HueBridge(settings));
+			if(settings->type == "huebridge-sim") device.reset(new SimulatedHueBridge(settings));
+			else device.reset(new HueBridge(settings));
 		}
 		else if(settings->type.empty()) //Deleted device
 		{
@@ -243,7 +245,7 @@ void Interfaces::create()
 	{
 		for(auto settings : _physicalInterfaceSettings)
 		{
-			if(settings.second->type == "huebridge" && settings.second->address > 255) settings.second->address = 255;
+			if((settings.second->type == "huebridge" || settings.second->type == "huebridge-sim") && settings.second->address > 255) settings.second->address = 255;
 			addInterface(settings.second, false);
 		}
 		if(!_defaultPhysicalInterface)
@@ -0,0 +1,130 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+
+#include "JsonMemberScanner.h"
+
+namespace PhilipsHue {
+
+size_t JsonMemberScanner::skipWhitespace(const std::string &json, size_t pos) {
+  while (pos < json.size() && (json[pos] == ' ' || json[pos] == '\t' || json[pos] == '\r' || json[pos] == '\n')) pos++;
+  return pos;
+}
+
+size_t JsonMemberScanner::skipString(const std::string &json, size_t pos) {
+  //"pos" points to the opening quote.
+  for (pos++; pos < json.size(); pos++) {
+    if (json[pos] == '\\') pos++;
+    else if (json[pos] == '"') return pos + 1;
+  }
+  return std::string::npos;
+}
+
+size_t JsonMemberScanner::skipValue(const std::string &json, size_t pos) {
+  if (pos >= json.size()) return std::string::npos;
+  if (json[pos] == '"') return skipString(json, pos);
+  if (json[pos] == '{' || json[pos] == '[') {
+    int32_t depth = 0;
+    while (pos < json.size()) {
+      char c = json[pos];
+      if (c == '"') {
+        pos = skipString(json, pos);
+        if (pos == std::string::npos) return pos;
+        continue;
+      }
+      if (c == '{' || c == '[') depth++;
+      else if (c == '}' || c == ']') {
+        depth--;
+        if (depth == 0) return pos + 1;
+      }
+      pos++;
+    }
+    return std::string::npos;
+  }
+
+  //Number, true, false or null
+  size_t start = pos;
+  while (pos < json.size() && json[pos] != ',' && json[pos] != '}' && json[pos] != ']' && json[pos] != ' ' && json[pos] != '\t' && json[pos] != '\r' && json[pos] != '\n') pos++;
+  return pos == start ? std::string::npos : pos;
+}
+
+bool JsonMemberScanner::findMembers(const std::string &json, const std::vector<std::string> &names, std::vector<Span> &spans) {
+  spans.clear();
+  spans.resize(names.size());
+
+  size_t pos = skipWhitespace(json, 0);
+  if (pos >= json.size() || json[pos] != '{') return false;
+  pos = skipWhitespace(json, pos + 1);
+  if (pos < json.size() && json[pos] == '}') return true;
+
+  while (pos < json.size()) {
+    if (json[pos] != '"') return false;
+    size_t keyStart = pos + 1;
+    pos = skipString(json, pos);
+    if (pos == std::string::npos) return false;
+    size_t keySize = pos - keyStart - 1;
+
+    pos = skipWhitespace(json, pos);
+    if (pos >= json.size() || json[pos] != ':') return false;
+    pos = skipWhitespace(json, pos + 1);
+
+    size_t valueStart = pos;
+    pos = skipValue(json, pos);
+    if (pos == std::string::npos) return false;
+
+    for (size_t i = 0; i < names.size(); i++) {
+      if (names[i].size() == keySize && json.compare(keyStart, keySize, names[i]) == 0) {
+        spans[i].start = valueStart;
+        spans[i].size = pos - valueStart;
+        break;
+      }
+    }
+
+    pos = skipWhitespace(json, pos);
+    if (pos >= json.size()) return false;
+    if (json[pos] == '}') return true;
+    if (json[pos] != ',') return false;
+    pos = skipWhitespace(json, pos + 1);
+  }
+  return false;
+}
+
+BaseLib::PVariable JsonMemberScanner::decodeMembers(BaseLib::Rpc::JsonDecoder &decoder, const std::string &json, const std::vector<std::string> &names) {
+  std::vector<Span> spans;
+  if (!findMembers(json, names, spans)) return BaseLib::PVariable();
+
+  auto result = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+  for (size_t i = 0; i < names.size(); i++) {
+    if (spans[i].size == 0) continue;
+    result->structValue->emplace(names[i], decoder.decode(json.substr(spans[i].start, spans[i].size)));
+  }
+  return result;
+}
+
+}
@@ -0,0 +1,80 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+
+#ifndef JSONMEMBERSCANNER_H_
+#define JSONMEMBERSCANNER_H_
+
+#include <homegear-base/BaseLib.h>
+
+#include <string>
+#include <vector>
+
+namespace PhilipsHue {
+
+/**
+ * Locates members of a JSON object without decoding the document. The hue bridge returns its complete configuration (including scenes, rules, schedules, ...) on "GET /api/<username>". Most of it is never used by the module, so only the needed members are passed to the JSON decoder.
+ */
+class JsonMemberScanner {
+ public:
+  struct Span {
+    size_t start = 0;
+    size_t size = 0;
+  };
+
+  JsonMemberScanner() = delete;
+
+  /**
+   * Finds the values of top level members of a JSON object. Nothing is copied or allocated (except for resizing "spans").
+   *
+   * @param json The JSON document.
+   * @param names The member names to search for.
+   * @param[out] spans One span per element in "names" pointing to the raw value within "json". Spans of members that don't exist have a size of 0.
+   * @return Returns "false" if "json" is not a valid JSON object.
+   */
+  static bool findMembers(const std::string &json, const std::vector<std::string> &names, std::vector<Span> &spans);
+
+  /**
+   * Decodes only the given top level members of a JSON object.
+   *
+   * @param decoder The decoder to use for the members.
+   * @param json The JSON document.
+   * @param names The member names to decode.
+   * @return Returns a struct containing the decoded members or nullptr if "json" is not a valid JSON object. Throws JsonDecoderException when a member can't be decoded.
+   */
+  static BaseLib::PVariable decodeMembers(BaseLib::Rpc::JsonDecoder &decoder, const std::string &json, const std::vector<std::string> &names);
+ private:
+  static size_t skipWhitespace(const std::string &json, size_t pos);
+  static size_t skipString(const std::string &json, size_t pos);
+  static size_t skipValue(const std::string &json, size_t pos);
+};
+
+}
+
+#endif
@@ -0,0 +1,109 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+
+#include "LatencyHistogram.h"
+
+#include <cmath>
+
+namespace PhilipsHue {
+
+LatencyHistogram::LatencyHistogram() {
+  for (auto &bucket : _buckets) {
+    bucket = 0;
+  }
+}
+
+uint32_t LatencyHistogram::getBucket(int64_t value) {
+  if (value < (int64_t)_subBuckets) return value < 0 ? 0 : (uint32_t)value;
+  uint32_t exponent = 63 - __builtin_clzll((uint64_t)value);
+  if (exponent > _maxExponent) return _bucketCount - 1;
+  uint32_t shift = exponent - _subBucketBits;
+  return _subBuckets + shift * _subBuckets + (uint32_t)((value >> shift) - _subBuckets);
+}
+
+int64_t LatencyHistogram::getBucketMaximum(uint32_t bucket) {
+  if (bucket < _subBuckets) return bucket;
+  uint32_t shift = (bucket - _subBuckets) / _subBuckets;
+  int64_t subBucket = (bucket - _subBuckets) % _subBuckets;
+  return ((_subBuckets + subBucket + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(int64_t microseconds) {
+  if (microseconds < 0) microseconds = 0;
+  _buckets[getBucket(microseconds)]++;
+  _count++;
+  _sum += microseconds;
+
+  int64_t min = _min;
+  while (microseconds < min && !_min.compare_exchange_weak(min, microseconds));
+  int64_t max = _max;
+  while (microseconds > max && !_max.compare_exchange_weak(max, microseconds));
+}
+
+int64_t LatencyHistogram::percentile(double percentile) {
+  uint64_t count = _count;
+  if (count == 0) return 0;
+  if (percentile > 100.0) percentile = 100.0;
+  uint64_t rank = (uint64_t)std::ceil(percentile / 100.0 * (double)count);
+  if (rank < 1) rank = 1;
+
+  uint64_t currentCount = 0;
+  for (uint32_t i = 0; i < _bucketCount; i++) {
+    currentCount += _buckets[i];
+    if (currentCount >= rank) return i == _bucketCount - 1 ? (int64_t)_max : std::min(getBucketMaximum(i), (int64_t)_max);
+  }
+  return _max;
+}
+
+BaseLib::PVariable LatencyHistogram::toVariable() {
+  auto histogram = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+  uint64_t count = _count;
+  histogram->structValue->emplace("count", std::make_shared<BaseLib::Variable>((int64_t)count));
+  histogram->structValue->emplace("min", std::make_shared<BaseLib::Variable>(count == 0 ? (int64_t)0 : (int64_t)_min));
+  histogram->structValue->emplace("mean", std::make_shared<BaseLib::Variable>(count == 0 ? (int64_t)0 : _sum / (int64_t)count));
+  histogram->structValue->emplace("max", std::make_shared<BaseLib::Variable>((int64_t)_max));
+  histogram->structValue->emplace("p50", std::make_shared<BaseLib::Variable>(percentile(50.0)));
+  histogram->structValue->emplace("p90", std::make_shared<BaseLib::Variable>(percentile(90.0)));
+  histogram->structValue->emplace("p99", std::make_shared<BaseLib::Variable>(percentile(99.0)));
+  histogram->structValue->emplace("p999", std::make_shared<BaseLib::Variable>(percentile(99.9)));
+  return histogram;
+}
+
+void LatencyHistogram::reset() {
+  for (auto &bucket : _buckets) {
+    bucket = 0;
+  }
+  _count = 0;
+  _sum = 0;
+  _min = INT64_MAX;
+  _max = 0;
+}
+
+}
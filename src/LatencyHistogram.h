@@ -0,0 +1,89 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+
+#ifndef LATENCYHISTOGRAM_H_
+#define LATENCYHISTOGRAM_H_
+
+#include <homegear-base/BaseLib.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace PhilipsHue {
+
+/**
+ * Records durations in a histogram with logarithmic buckets similar to HdrHistogram. Every power of two is split into 16 linear sub-buckets, so reported percentiles are at most about 6 % above the actual value. Recording is lock free and can be done from any thread.
+ */
+class LatencyHistogram {
+ public:
+  LatencyHistogram();
+
+  /**
+   * Records one duration.
+   *
+   * @param microseconds The duration in microseconds.
+   */
+  void record(int64_t microseconds);
+
+  uint64_t count() { return _count; }
+
+  /**
+   * Returns the highest value in the bucket containing the given percentile.
+   *
+   * @param percentile The percentile between 0 and 100.
+   * @return The value in microseconds.
+   */
+  int64_t percentile(double percentile);
+
+  /**
+   * Returns the count, minimum, mean, maximum and the 50th, 90th, 99th and 99.9th percentile in microseconds as a struct.
+   */
+  BaseLib::PVariable toVariable();
+  void reset();
+ private:
+  static constexpr uint32_t _subBucketBits = 4;
+  static constexpr uint32_t _subBuckets = 1 << _subBucketBits;
+  static constexpr uint32_t _maxExponent = 40; //About 12 days in microseconds. Larger values are counted in the last bucket.
+  static constexpr uint32_t _bucketCount = _subBuckets + (_maxExponent - _subBucketBits + 1) * _subBuckets;
+
+  std::array<std::atomic<uint64_t>, _bucketCount> _buckets;
+  std::atomic<uint64_t> _count{0};
+  std::atomic<int64_t> _sum{0};
+  std::atomic<int64_t> _min{INT64_MAX};
+  std::atomic<int64_t> _max{0};
+
+  static uint32_t getBucket(int64_t value);
+  static int64_t getBucketMaximum(uint32_t bucket);
+};
+
+}
+
+#endif
@@ -0,0 +1,112 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+
+
+#include "PacketBindings.h"
+#include "GD.h"
+
+namespace PhilipsHue {
+
+std::mutex PacketBindings::_cacheMutex;
+std::map<const BaseLib::DeviceDescription::HomegearDevice *, std::pair<std::weak_ptr<BaseLib::DeviceDescription::HomegearDevice>, std::shared_ptr<PacketBindings>>> PacketBindings::_cache;
+
+PacketBindings::PacketBindings(const std::shared_ptr<BaseLib::DeviceDescription::HomegearDevice> &device) : _device(device.get()) {
+  try {
+    for (auto &element : device->packetsByMessageType) {
+      if (!element.second) continue;
+      if (_framesByMessageType.empty() || _framesByMessageType.back().first != element.first) _framesByMessageType.emplace_back(element.first, std::vector<FrameBinding>());
+      FrameBinding frameBinding;
+      compileFrame(device, element.second, frameBinding);
+      if (!frameBinding.parameters.empty()) _framesByMessageType.back().second.push_back(std::move(frameBinding));
+    }
+  }
+  catch (const std::exception &ex) {
+    GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void PacketBindings::compileFrame(const std::shared_ptr<BaseLib::DeviceDescription::HomegearDevice> &device, const BaseLib::DeviceDescription::PPacket &frame, FrameBinding &frameBinding) {
+  frameBinding.frame = frame;
+  int32_t startChannel = frame->channel < 0 ? 0 : frame->channel;
+  int32_t endChannel = startChannel;
+  //When the channel is -2 (means '*') the frame is bound to all channels having the parameter
+  if (frame->channel == -2) {
+    startChannel = 0;
+    endChannel = device->functions.empty() ? -1 : (int32_t)device->functions.rbegin()->first;
+  }
+
+  for (auto &payload : frame->jsonPayloads) {
+    for (auto &parameter : frame->associatedVariables) {
+      if (parameter->physical->groupId != payload->parameterId) continue;
+      ParameterBinding binding;
+      for (int32_t channel = startChannel; channel <= endChannel; channel++) {
+        auto functionIterator = device->functions.find(channel);
+        if (functionIterator == device->functions.end()) continue;
+        BaseLib::DeviceDescription::PParameterGroup parameterGroup = functionIterator->second->getParameterGroup(parameter->parent()->type());
+        if (!parameterGroup || parameterGroup->parameters.find(parameter->id) == parameterGroup->parameters.end()) continue;
+        binding.channels.push_back(channel);
+      }
+      if (binding.channels.empty()) continue;
+
+      binding.key = payload->key;
+      binding.subkey = payload->subkey;
+      binding.sameKeyAsPrevious = !frameBinding.parameters.empty() && frameBinding.parameters.back().key == binding.key;
+      binding.parameter = parameter;
+      binding.isState = parameter->id == "STATE";
+      binding.conversion = ValueConverter::getType(parameter);
+      frameBinding.parameters.push_back(std::move(binding));
+    }
+  }
+}
+
+std::shared_ptr<PacketBindings> PacketBindings::get(const std::shared_ptr<BaseLib::DeviceDescription::HomegearDevice> &device) {
+  if (!device) return std::shared_ptr<PacketBindings>();
+  std::lock_guard<std::mutex> cacheGuard(_cacheMutex);
+  auto cacheIterator = _cache.find(device.get());
+  //Compare the owner, too. A reloaded device description might have the address of a deleted one.
+  if (cacheIterator != _cache.end() && cacheIterator->second.first.lock() == device) return cacheIterator->second.second;
+
+  for (auto i = _cache.begin(); i != _cache.end();) {
+    if (i->second.first.expired()) i = _cache.erase(i);
+    else ++i;
+  }
+  auto bindings = std::make_shared<PacketBindings>(device);
+  _cache[device.get()] = std::make_pair(std::weak_ptr<BaseLib::DeviceDescription::HomegearDevice>(device), bindings);
+  return bindings;
+}
+
+const std::vector<FrameBinding> &PacketBindings::frames(uint32_t messageType) const {
+  for (auto &element : _framesByMessageType) {
+    if (element.first == messageType) return element.second;
+  }
+  return _noFrames;
+}
+
+}
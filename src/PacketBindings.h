@@ -0,0 +1,94 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+
+
+#ifndef PACKETBINDINGS_H_
+#define PACKETBINDINGS_H_
+
+#include "ValueConverter.h"
+
+#include <homegear-base/BaseLib.h>
+
+#include <map>
+#include <mutex>
+
+namespace PhilipsHue {
+
+/**
+ * Binds one value of the JSON of a packet (e. g. "state" => "bri") to a parameter.
+ */
+struct ParameterBinding {
+  std::string key;
+  std::string subkey;
+  bool sameKeyAsPrevious = false; //"key" equals the key of the previous binding of the frame, so the looked up JSON object can be reused.
+  BaseLib::DeviceDescription::PParameter parameter;
+  bool isState = false;
+  ValueConverter::Type conversion = ValueConverter::Type::generic;
+  std::vector<uint32_t> channels; //The channels of the frame having the parameter. Never empty.
+};
+
+struct FrameBinding {
+  BaseLib::DeviceDescription::PPacket frame;
+  std::vector<ParameterBinding> parameters;
+};
+
+/**
+ * The bindings of all packets of a device description. They only depend on the device description, so they are compiled once
+ * and shared by all peers of the device type. Processing a packet is then a linear pass over the bindings of its message type.
+ */
+class PacketBindings {
+ public:
+  explicit PacketBindings(const std::shared_ptr<BaseLib::DeviceDescription::HomegearDevice> &device);
+
+  /**
+   * Returns the bindings of a device description and compiles them on first use.
+   */
+  static std::shared_ptr<PacketBindings> get(const std::shared_ptr<BaseLib::DeviceDescription::HomegearDevice> &device);
+
+  const BaseLib::DeviceDescription::HomegearDevice *device() const { return _device; }
+
+  /**
+   * Returns the bindings of all frames of a message type in the order of the device description.
+   */
+  const std::vector<FrameBinding> &frames(uint32_t messageType) const;
+ private:
+  const BaseLib::DeviceDescription::HomegearDevice *_device = nullptr;
+  std::vector<std::pair<uint32_t, std::vector<FrameBinding>>> _framesByMessageType; //Devices only have a handful of message types, so a linear search is faster than a map.
+  const std::vector<FrameBinding> _noFrames;
+
+  static std::mutex _cacheMutex;
+  static std::map<const BaseLib::DeviceDescription::HomegearDevice *, std::pair<std::weak_ptr<BaseLib::DeviceDescription::HomegearDevice>, std::shared_ptr<PacketBindings>>> _cache;
+
+  void compileFrame(const std::shared_ptr<BaseLib::DeviceDescription::HomegearDevice> &device, const BaseLib::DeviceDescription::PPacket &frame, FrameBinding &frameBinding);
+};
+
+}
+
+#endif
@@ -0,0 +1,154 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+
+
+#include "PersistenceQueue.h"
+#include "GD.h"
+#include "PhilipsHueCentral.h"
+
+namespace PhilipsHue {
+
+PersistenceQueue::PersistenceQueue(int64_t interval, uint32_t batchSize, int64_t debounceInterval, std::unordered_map<std::string, Policy> policies) : _interval(interval), _batchSize(batchSize), _debounceInterval(debounceInterval), _policies(std::move(policies)) {
+  if (_interval > 0 && _interval < 100) _interval = 100;
+  if (_batchSize < 1) _batchSize = 1;
+  if (_debounceInterval < 0) _debounceInterval = 0;
+  if (GD::scheduler) _flushTask = GD::scheduler->add(std::bind(&PersistenceQueue::flushTask, this), BaseLib::HelperFunctions::getTime() + (_interval > 0 ? _interval : 1000));
+}
+
+PersistenceQueue::~PersistenceQueue() {
+  if (_flushTask != -1 && GD::scheduler) GD::scheduler->remove(_flushTask);
+  flush(true);
+}
+
+PersistenceQueue::Policy PersistenceQueue::getPolicy(const std::string &parameterId) {
+  if (_policies.empty()) return Policy::always;
+  auto policyIterator = _policies.find(parameterId);
+  return policyIterator == _policies.end() ? Policy::always : policyIterator->second;
+}
+
+bool PersistenceQueue::enqueue(uint64_t peerId, uint64_t databaseId, Policy policy, const std::vector<uint8_t> &data) {
+  if (policy == Policy::always && _interval <= 0) return false;
+  bool flushNow = false;
+  {
+    std::lock_guard<std::mutex> queueGuard(_queueMutex);
+    Entry &entry = _queue[databaseId];
+    if (entry.peerId != 0) _coalescedRows++;
+    else {
+      //Only new entries get a due time, so a parameter changing all the time is still written.
+      if (policy == Policy::always) {
+        entry.dueTime = 0;
+        _dueRows++;
+      } else if (policy == Policy::debounced) {
+        auto lastWriteIterator = _lastWriteTimes.find(databaseId);
+        entry.dueTime = lastWriteIterator == _lastWriteTimes.end() ? 0 : lastWriteIterator->second + _debounceInterval;
+      } else entry.dueTime = INT64_MAX;
+    }
+    entry.peerId = peerId;
+    entry.policy = policy;
+    entry.data = data;
+    flushNow = _dueRows >= _batchSize;
+  }
+  _enqueuedRows++;
+  if (flushNow && _flushTask != -1 && GD::scheduler) GD::scheduler->wake(_flushTask);
+  return true;
+}
+
+int64_t PersistenceQueue::flushTask() {
+  flush(false);
+  return BaseLib::HelperFunctions::getTime() + (_interval > 0 ? _interval : 1000);
+}
+
+void PersistenceQueue::flush(bool all) {
+  try {
+    std::lock_guard<std::mutex> flushGuard(_flushMutex);
+    int64_t time = BaseLib::HelperFunctions::getTime();
+    std::unordered_map<uint64_t, Entry> queue;
+    {
+      std::lock_guard<std::mutex> queueGuard(_queueMutex);
+      if (_queue.empty()) return;
+      if (all) queue.swap(_queue);
+      else {
+        for (auto i = _queue.begin(); i != _queue.end();) {
+          if (i->second.dueTime <= time) {
+            queue.emplace(i->first, std::move(i->second));
+            i = _queue.erase(i);
+          } else ++i;
+        }
+      }
+      _dueRows = 0;
+      for (auto &element : queue) {
+        if (element.second.policy == Policy::debounced) _lastWriteTimes[element.first] = time;
+      }
+    }
+    if (queue.empty()) return;
+
+    int64_t startTime = BaseLib::HelperFunctions::getTimeMicroseconds();
+    //Group the parameters by peer, so every peer is looked up only once.
+    std::unordered_map<uint64_t, std::vector<std::pair<uint64_t, std::vector<uint8_t>>>> rowsByPeer;
+    for (auto &element : queue) {
+      rowsByPeer[element.second.peerId].emplace_back(element.first, std::move(element.second.data));
+    }
+
+    auto central = GD::family ? std::dynamic_pointer_cast<PhilipsHueCentral>(GD::family->getCentral()) : std::shared_ptr<PhilipsHueCentral>();
+    for (auto &element : rowsByPeer) {
+      auto peer = central ? central->getPeer(element.first) : std::shared_ptr<PhilipsHuePeer>();
+      if (!peer) {
+        _droppedRows += element.second.size();
+        continue;
+      }
+      peer->saveParameters(element.second);
+      _flushedRows += element.second.size();
+    }
+    _flushes++;
+    _lastFlushDuration = BaseLib::HelperFunctions::getTimeMicroseconds() - startTime;
+  }
+  catch (const std::exception &ex) {
+    GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+BaseLib::PVariable PersistenceQueue::getStatistics() {
+  auto statistics = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+  size_t queuedRows = 0;
+  {
+    std::lock_guard<std::mutex> queueGuard(_queueMutex);
+    queuedRows = _queue.size();
+  }
+  statistics->structValue->emplace("queuedRows", std::make_shared<BaseLib::Variable>((int64_t)queuedRows));
+  statistics->structValue->emplace("enqueuedRows", std::make_shared<BaseLib::Variable>((int64_t)_enqueuedRows));
+  statistics->structValue->emplace("coalescedRows", std::make_shared<BaseLib::Variable>((int64_t)_coalescedRows));
+  statistics->structValue->emplace("flushedRows", std::make_shared<BaseLib::Variable>((int64_t)_flushedRows));
+  statistics->structValue->emplace("droppedRows", std::make_shared<BaseLib::Variable>((int64_t)_droppedRows));
+  statistics->structValue->emplace("flushes", std::make_shared<BaseLib::Variable>((int64_t)_flushes));
+  statistics->structValue->emplace("lastFlushDuration", std::make_shared<BaseLib::Variable>((int64_t)_lastFlushDuration));
+  return statistics;
+}
+
+}
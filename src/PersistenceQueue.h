@@ -0,0 +1,129 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+
+
+#ifndef PERSISTENCEQUEUE_H_
+#define PERSISTENCEQUEUE_H_
+
+#include <homegear-base/BaseLib.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace PhilipsHue {
+
+/**
+ * Collects parameter values of all peers and writes them to the database in batches (write-behind). Writing a parameter again
+ * before it was flushed replaces the queued value, so a parameter changing with every poll is only written once per flush.
+ * The queue is flushed every "interval" milliseconds, as soon as "batchSize" parameters are queued and on shutdown by
+ * PhilipsHueCentral::savePeers().
+ *
+ * Transient parameters can be written less often by a persistence policy (see Policy).
+ */
+class PersistenceQueue {
+ public:
+  enum class Policy {
+    always, //Written with the next flush (or immediately when write-behind is disabled).
+    debounced, //Written at most once every "debounceInterval" milliseconds. The last value is always written.
+    memoryOnly //Only written on shutdown.
+  };
+
+  /**
+   * @param interval The time in milliseconds between two flushes. When 0 or less, parameters with the policy "always" are not
+   * queued.
+   * @param batchSize The number of queued parameters triggering a flush before the interval elapsed.
+   * @param debounceInterval The minimum time in milliseconds between two writes of a debounced parameter.
+   * @param policies The policies of parameters other than "always", indexed by parameter ID.
+   */
+  PersistenceQueue(int64_t interval, uint32_t batchSize, int64_t debounceInterval, std::unordered_map<std::string, Policy> policies);
+  ~PersistenceQueue();
+
+  /**
+   * Returns the policy of a parameter.
+   */
+  Policy getPolicy(const std::string &parameterId);
+
+  /**
+   * Queues the data of a parameter already stored in the database.
+   *
+   * @param peerId The ID of the peer the parameter belongs to.
+   * @param databaseId The database ID of the parameter.
+   * @param policy The policy of the parameter.
+   * @param data The data to write.
+   * @return Returns false, when the data was not queued and needs to be written immediately.
+   */
+  bool enqueue(uint64_t peerId, uint64_t databaseId, Policy policy, const std::vector<uint8_t> &data);
+
+  /**
+   * Writes the queued parameters. Parameters of peers not existing anymore are dropped.
+   *
+   * @param all Also write debounced parameters not due yet and memory only parameters.
+   */
+  void flush(bool all);
+
+  /**
+   * Returns the number of queued, coalesced and flushed parameters and the number of flushes.
+   */
+  BaseLib::PVariable getStatistics();
+ private:
+  struct Entry {
+    uint64_t peerId = 0;
+    Policy policy = Policy::always;
+    int64_t dueTime = 0;
+    std::vector<uint8_t> data;
+  };
+
+  int64_t _interval = 5000;
+  uint32_t _batchSize = 500;
+  int64_t _debounceInterval = 30000;
+  std::unordered_map<std::string, Policy> _policies;
+  int32_t _flushTask = -1;
+
+  std::mutex _queueMutex;
+  std::unordered_map<uint64_t, Entry> _queue; //Indexed by database ID
+  uint32_t _dueRows = 0; //Number of entries with the policy "always"
+  std::unordered_map<uint64_t, int64_t> _lastWriteTimes; //Of debounced parameters, indexed by database ID
+  std::mutex _flushMutex; //Keeps the order of the writes, when flush() is called from several threads.
+
+  std::atomic<uint64_t> _enqueuedRows{0};
+  std::atomic<uint64_t> _coalescedRows{0};
+  std::atomic<uint64_t> _flushedRows{0};
+  std::atomic<uint64_t> _droppedRows{0};
+  std::atomic<uint64_t> _flushes{0};
+  std::atomic<int64_t> _lastFlushDuration{0};
+
+  int64_t flushTask();
+};
+
+}
+
+#endif
@@ -39,6 +39,20 @@
 namespace PhilipsHue
 {
 
+/**
+ * Adds a policy for a comma separated list of variable IDs.
+ */
+static void addPersistencePolicies(const std::string& variables, PersistenceQueue::Policy policy, std::unordered_map<std::string, PersistenceQueue::Policy>& policies)
+{
+	std::vector<std::string> ids = BaseLib::HelperFunctions::splitAll(variables, ',');
+	for(auto& id : ids)
+	{
+		BaseLib::HelperFunctions::trim(id);
+		BaseLib::HelperFunctions::toUpper(id);
+		if(!id.empty()) policies[id] = policy;
+	}
+}
+
 PhilipsHue::PhilipsHue(BaseLib::SharedObjects* bl, BaseLib::Systems::IFamilyEventSink* eventHandler) : BaseLib::Systems::DeviceFamily(bl, eventHandler, HUE_FAMILY_ID, HUE_FAMILY_NAME)
 {
 	GD::bl = _bl;
@@ -46,6 +60,26 @@ PhilipsHue::PhilipsHue(BaseLib::SharedObjects* bl, BaseLib::Systems::IFamilyEven
 	GD::out.init(bl);
 	GD::out.setPrefix("Module Philips hue: ");
 	GD::out.printDebug("Debug: Loading module...");
+	std::string settingName = "bridgethreads";
+	auto setting = getFamilySetting(settingName);
+	GD::scheduler.reset(new Scheduler(setting && setting->integerValue > 0 ? (uint32_t)setting->integerValue : 4));
+	settingName = "persistenceinterval";
+	setting = getFamilySetting(settingName);
+	int64_t persistenceInterval = setting ? setting->integerValue : 5000;
+	settingName = "persistencebatchsize";
+	setting = getFamilySetting(settingName);
+	uint32_t persistenceBatchSize = setting && setting->integerValue > 0 ? (uint32_t)setting->integerValue : 500;
+	settingName = "debounceinterval";
+	setting = getFamilySetting(settingName);
+	int64_t debounceInterval = (setting ? setting->integerValue : 30) * 1000;
+	std::unordered_map<std::string, PersistenceQueue::Policy> persistencePolicies;
+	settingName = "debouncedvariables";
+	setting = getFamilySetting(settingName);
+	addPersistencePolicies(setting ? setting->stringValue : "BRIGHTNESS,FAST_BRIGHTNESS,HUE,SATURATION,XY,COLOR_TEMPERATURE,RGB", PersistenceQueue::Policy::debounced, persistencePolicies);
+	settingName = "memoryonlyvariables";
+	setting = getFamilySetting(settingName);
+	addPersistencePolicies(setting ? setting->stringValue : "REACHABLE,ALERT,EFFECT", PersistenceQueue::Policy::memoryOnly, persistencePolicies);
+	if(persistenceInterval > 0 || !persistencePolicies.empty()) GD::persistenceQueue.reset(new PersistenceQueue(persistenceInterval, persistenceBatchSize, debounceInterval, persistencePolicies));
 	GD::interfaces = std::make_shared<Interfaces>(bl, _settings->getPhysicalInterfaceSettings());
 	_physicalInterfaces = GD::interfaces;
 }
@@ -59,9 +93,11 @@ void PhilipsHue::dispose()
 {
 	if(_disposed) return;
 	DeviceFamily::dispose();
+	GD::persistenceQueue.reset(); //Writes the remaining parameters, so it needs the central.
     _central.reset();
 	GD::interfaces.reset();
 	_physicalInterfaces.reset();
+	GD::scheduler.reset();
 }
 
 std::shared_ptr<BaseLib::Systems::ICentral> PhilipsHue::initializeCentral(uint32_t deviceId, int32_t address, std::string serialNumber)
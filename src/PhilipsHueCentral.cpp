@@ -29,11 +29,16 @@
 
 #include "PhilipsHueCentral.h"
 #include "GD.h"
+#include "JsonMemberScanner.h"
 
+#include <deque>
 #include <iomanip>
+#include <thread>
 
 namespace PhilipsHue {
 
+thread_local const std::string *PhilipsHueCentral::_batchInterfaceId = nullptr;
+
 PhilipsHueCentral::PhilipsHueCentral(ICentralEventSink *eventHandler) : BaseLib::Systems::ICentral(HUE_FAMILY_ID, GD::bl, eventHandler) {
   init();
 }
@@ -46,8 +51,26 @@ void PhilipsHueCentral::init() {
   _stopWorkerThread = false;
   _shuttingDown = false;
   _searching = false;
+  _peerIndex = std::make_shared<PeerIndex>();
+
+  std::string settingName = "batchevents";
+  auto setting = GD::family->getFamilySetting(settingName);
+  if (setting) {
+    std::string value = setting->stringValue;
+    _batchEvents = (setting->integerValue == 1 || BaseLib::HelperFunctions::toLower(value) == "true");
+  }
+  settingName = "batchedpeerevents";
+  setting = GD::family->getFamilySetting(settingName);
+  if (setting) {
+    std::string value = setting->stringValue;
+    _raiseBatchedPeerEvents = (setting->integerValue == 1 || BaseLib::HelperFunctions::toLower(value) == "true");
+  }
+
   GD::interfaces->addEventHandlers((BaseLib::Systems::IPhysicalInterface::IPhysicalInterfaceEventSink *)this);
 
+  _localRpcMethods.emplace("getBridgeMetrics", std::bind(&PhilipsHueCentral::getBridgeMetrics, this, std::placeholders::_1, std::placeholders::_2));
+  _localRpcMethods.emplace("setValues", std::bind(&PhilipsHueCentral::setValues, this, std::placeholders::_1, std::placeholders::_2));
+
   GD::bl->threadManager.start(_workerThread, true, _bl->settings.workerThreadPriority(), _bl->settings.workerThreadPolicy(), &PhilipsHueCentral::worker, this);
 }
 
@@ -76,8 +99,12 @@ bool PhilipsHueCentral::onPacketReceived(std::string &senderID, std::shared_ptr<
     if (_disposing) return false;
     std::shared_ptr<PhilipsHuePacket> philipsHuePacket(std::dynamic_pointer_cast<PhilipsHuePacket>(packet));
     if (!philipsHuePacket) return false;
+    if (philipsHuePacket->getMessageType() == HUE_BATCH_END_MESSAGE_TYPE) {
+      if (_batchEvents) raiseEventBatch(senderID);
+      return false;
+    }
     std::shared_ptr<PhilipsHuePeer> peer;
-    if (philipsHuePacket->getCategory() == PhilipsHuePacket::Category::light) peer = getPeer(philipsHuePacket->senderAddress());
+    if (philipsHuePacket->getCategory() == PhilipsHuePacket::Category::light || philipsHuePacket->getCategory() == PhilipsHuePacket::Category::sensor) peer = getPeer(philipsHuePacket->senderAddress());
     else {
       std::string serialNumber = "*HUE";
       std::string addressString = BaseLib::HelperFunctions::getHexString(philipsHuePacket->senderAddress());
@@ -86,40 +113,157 @@ bool PhilipsHueCentral::onPacketReceived(std::string &senderID, std::shared_ptr<
       peer = getPeer(serialNumber);
     }
     if (!peer) return false;
-    peer->packetReceived(philipsHuePacket);
+    if (_batchEvents) {
+      _batchInterfaceId = &senderID;
+      peer->packetReceived(philipsHuePacket);
+      _batchInterfaceId = nullptr;
+    } else peer->packetReceived(philipsHuePacket);
   }
   catch (const std::exception &ex) {
+    _batchInterfaceId = nullptr;
     GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
   }
   return false;
 }
 
-void PhilipsHueCentral::sendPacket(std::shared_ptr<IPhilipsHueInterface> &interface, std::shared_ptr<PhilipsHuePacket> packet) {
+void PhilipsHueCentral::BatchedValues::set(const std::string &key, const PVariable &value) {
+  for (size_t i = 0; i < keys.size(); i++) {
+    if (keys[i] == key) {
+      values[i] = value;
+      return;
+    }
+  }
+  keys.push_back(key);
+  values.push_back(value);
+}
+
+void PhilipsHueCentral::onEvent(std::string &source, uint64_t peerId, int32_t channel, std::shared_ptr<std::vector<std::string>> &variables, std::shared_ptr<std::vector<BaseLib::PVariable>> &values) {
+  if (!_batchInterfaceId || !variables || !values) {
+    ICentral::onEvent(source, peerId, channel, variables, values);
+    return;
+  }
   try {
-    if (!packet) return;
-    uint32_t responseDelay = interface->responseDelay();
-    std::shared_ptr<PacketManager> packetManager = _sentPackets[interface->getID()];
-    if (!packetManager) {
-      packetManager.reset(new PacketManager());
-      _sentPackets[interface->getID()] = packetManager;
+    std::lock_guard<std::mutex> eventBatchesGuard(_eventBatchesMutex);
+    auto &batch = _eventBatches[*_batchInterfaceId];
+    if (batch.channels.empty()) batch.startTime = BaseLib::HelperFunctions::getTime();
+    auto &batchedChannel = batch.channels[std::make_pair(peerId, channel)];
+    batchedChannel.source = source;
+    for (size_t i = 0; i < variables->size() && i < values->size(); i++) {
+      batchedChannel.events.set(variables->at(i), values->at(i));
+    }
+  }
+  catch (const std::exception &ex) {
+    GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void PhilipsHueCentral::onRPCEvent(std::string &source, uint64_t peerId, int32_t channel, std::string &deviceAddress, std::shared_ptr<std::vector<std::string>> &valueKeys, std::shared_ptr<std::vector<BaseLib::PVariable>> &values) {
+  if (!_batchInterfaceId || !valueKeys || !values) {
+    ICentral::onRPCEvent(source, peerId, channel, deviceAddress, valueKeys, values);
+    return;
+  }
+  try {
+    std::lock_guard<std::mutex> eventBatchesGuard(_eventBatchesMutex);
+    auto &batch = _eventBatches[*_batchInterfaceId];
+    if (batch.channels.empty()) batch.startTime = BaseLib::HelperFunctions::getTime();
+    auto &batchedChannel = batch.channels[std::make_pair(peerId, channel)];
+    batchedChannel.source = source;
+    batchedChannel.address = deviceAddress;
+    for (size_t i = 0; i < valueKeys->size() && i < values->size(); i++) {
+      batchedChannel.rpcEvents.set(valueKeys->at(i), values->at(i));
+    }
+  }
+  catch (const std::exception &ex) {
+    GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void PhilipsHueCentral::raiseEventBatch(const std::string &interfaceId) {
+  try {
+    EventBatch batch;
+    {
+      std::lock_guard<std::mutex> eventBatchesGuard(_eventBatchesMutex);
+      auto batchIterator = _eventBatches.find(interfaceId);
+      if (batchIterator == _eventBatches.end()) return;
+      batch = std::move(batchIterator->second);
+      _eventBatches.erase(batchIterator);
+    }
+    if (batch.channels.empty()) return;
+
+    PVariable peers = std::make_shared<Variable>(VariableType::tStruct);
+    for (auto &channelIterator : batch.channels) {
+      auto &peerStruct = peers->structValue->emplace(std::to_string(channelIterator.first.first), std::make_shared<Variable>(VariableType::tStruct)).first->second;
+      PVariable channelStruct = std::make_shared<Variable>(VariableType::tStruct);
+      auto &events = channelIterator.second.events.keys.empty() ? channelIterator.second.rpcEvents : channelIterator.second.events;
+      for (size_t i = 0; i < events.keys.size(); i++) {
+        channelStruct->structValue->emplace(events.keys[i], events.values[i]);
+      }
+      peerStruct->structValue->emplace(std::to_string(channelIterator.first.second), channelStruct);
+    }
+
+    if (_raiseBatchedPeerEvents) {
+      for (auto &channelIterator : batch.channels) {
+        auto &batchedChannel = channelIterator.second;
+        if (!batchedChannel.events.keys.empty()) {
+          auto keys = std::make_shared<std::vector<std::string>>(std::move(batchedChannel.events.keys));
+          auto values = std::make_shared<std::vector<PVariable>>(std::move(batchedChannel.events.values));
+          ICentral::onEvent(batchedChannel.source, channelIterator.first.first, channelIterator.first.second, keys, values);
+        }
+        if (!batchedChannel.rpcEvents.keys.empty()) {
+          auto keys = std::make_shared<std::vector<std::string>>(std::move(batchedChannel.rpcEvents.keys));
+          auto values = std::make_shared<std::vector<PVariable>>(std::move(batchedChannel.rpcEvents.values));
+          ICentral::onRPCEvent(batchedChannel.source, channelIterator.first.first, channelIterator.first.second, batchedChannel.address, keys, values);
+        }
+      }
     }
-    std::shared_ptr<PhilipsHuePacketInfo> packetInfo = packetManager->getInfo(packet->destinationAddress());
-    packetManager->set(packet->destinationAddress(), packet);
-    if (packetInfo) {
-      int64_t timeDifference = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count() - packetInfo->time;
-      if (timeDifference < responseDelay) {
-        packetInfo->time += responseDelay - timeDifference; //Set to sending time
-        std::this_thread::sleep_for(std::chrono::milliseconds(responseDelay - timeDifference));
+
+    PVariable eventBatch = std::make_shared<Variable>(VariableType::tStruct);
+    eventBatch->structValue->emplace("BRIDGE", std::make_shared<Variable>(interfaceId));
+    eventBatch->structValue->emplace("PEERS", peers);
+    std::string eventSource = "device-0";
+    std::string address = _serialNumber + ":-1";
+    auto keys = std::make_shared<std::vector<std::string>>(std::initializer_list<std::string>{"EVENT_BATCH"});
+    auto values = std::make_shared<std::vector<PVariable>>(std::initializer_list<PVariable>{eventBatch});
+    ICentral::onEvent(eventSource, 0, -1, keys, values);
+    ICentral::onRPCEvent(eventSource, 0, -1, address, keys, values);
+  }
+  catch (const std::exception &ex) {
+    GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void PhilipsHueCentral::raiseStaleEventBatches(int64_t maxAge) {
+  try {
+    std::vector<std::string> interfaceIds;
+    {
+      std::lock_guard<std::mutex> eventBatchesGuard(_eventBatchesMutex);
+      int64_t time = BaseLib::HelperFunctions::getTime();
+      for (auto &batch : _eventBatches) {
+        if (time - batch.second.startTime >= maxAge) interfaceIds.push_back(batch.first);
       }
     }
-    packetManager->keepAlive(packet->destinationAddress());
-    interface->sendPacket(packet);
+    for (auto &interfaceId : interfaceIds) {
+      raiseEventBatch(interfaceId);
+    }
   }
   catch (const std::exception &ex) {
     GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
   }
 }
 
+bool PhilipsHueCentral::sendPacket(std::shared_ptr<IPhilipsHueInterface> &interface, std::shared_ptr<PhilipsHuePacket> packet, bool wait, IPhilipsHueInterface::CommandPriority priority) {
+  try {
+    if (!packet) return false;
+    std::future<bool> result = interface->queuePacket(packet, priority);
+    if (wait) return result.get();
+    return true;
+  }
+  catch (const std::exception &ex) {
+    GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return false;
+}
+
 uint32_t PhilipsHueCentral::getDeviceType(const std::string &manufacturer, const std::string &modelId, const std::string &type, PhilipsHuePacket::Category category) {
   try {
     if (modelId.length() < 4) return (uint32_t)DeviceType::none;
@@ -148,6 +292,7 @@ uint32_t PhilipsHueCentral::getDeviceType(const std::string &manufacturer, const
 void PhilipsHueCentral::loadPeers() {
   try {
     std::shared_ptr<BaseLib::Database::DataTable> rows = _bl->db->getPeers(_deviceId);
+    std::vector<std::shared_ptr<PhilipsHuePeer>> peers;
     std::vector<std::shared_ptr<PhilipsHuePeer>> teams;
     for (BaseLib::Database::DataTable::iterator row = rows->begin(); row != rows->end(); ++row) {
       int32_t peerID = row->second.at(0)->intValue;
@@ -156,12 +301,11 @@ void PhilipsHueCentral::loadPeers() {
       std::shared_ptr<PhilipsHuePeer> peer(new PhilipsHuePeer(peerID, address, row->second.at(3)->textValue, _deviceId, this));
       if (!peer->load(this)) continue;
       if (!peer->getRpcDevice()) continue;
-      std::lock_guard<std::mutex> peersGuard(_peersMutex);
-      if (!peer->isTeam()) _peers[peer->getAddress()] = peer;
-      else teams.push_back(peer);
-      if (!peer->getSerialNumber().empty()) _peersBySerial[peer->getSerialNumber()] = peer;
-      _peersById[peerID] = peer;
+      peers.push_back(peer);
+      if (peer->isTeam()) teams.push_back(peer);
     }
+    //Add all peers at once, so the index is only copied once.
+    addPeers(peers);
 
     for (auto team : teams) {
       std::set<uint64_t> teamPeers = team->getTeamPeers();
@@ -196,6 +340,8 @@ void PhilipsHueCentral::loadVariables() {
 
 void PhilipsHueCentral::savePeers(bool full) {
   try {
+    //Before locking "_peersMutex", because the queue looks up the peers.
+    if (GD::persistenceQueue) GD::persistenceQueue->flush(true);
     std::lock_guard<std::mutex> peersGuard(_peersMutex);
     for (std::unordered_map<int32_t, std::shared_ptr<BaseLib::Systems::Peer>>::iterator i = _peers.begin(); i != _peers.end(); ++i) {
       //Necessary, because peers can be assigned to multiple virtual devices
@@ -222,8 +368,9 @@ void PhilipsHueCentral::saveVariables() {
 
 std::shared_ptr<PhilipsHuePeer> PhilipsHueCentral::getPeer(int32_t address) {
   try {
-    std::lock_guard<std::mutex> peersGuard(_peersMutex);
-    if (_peers.find(address) != _peers.end()) return std::dynamic_pointer_cast<PhilipsHuePeer>(_peers.at(address));
+    std::shared_ptr<const PeerIndex> peerIndex = std::atomic_load(&_peerIndex);
+    auto peerIterator = peerIndex->byAddress.find(address);
+    if (peerIterator != peerIndex->byAddress.end()) return peerIterator->second;
   }
   catch (const std::exception &ex) {
     GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
@@ -233,8 +380,9 @@ std::shared_ptr<PhilipsHuePeer> PhilipsHueCentral::getPeer(int32_t address) {
 
 std::shared_ptr<PhilipsHuePeer> PhilipsHueCentral::getPeer(uint64_t id) {
   try {
-    std::lock_guard<std::mutex> peersGuard(_peersMutex);
-    if (_peersById.find(id) != _peersById.end()) return std::dynamic_pointer_cast<PhilipsHuePeer>(_peersById.at(id));
+    std::shared_ptr<const PeerIndex> peerIndex = std::atomic_load(&_peerIndex);
+    auto peerIterator = peerIndex->byId.find(id);
+    if (peerIterator != peerIndex->byId.end()) return peerIterator->second;
   }
   catch (const std::exception &ex) {
     GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
@@ -244,8 +392,9 @@ std::shared_ptr<PhilipsHuePeer> PhilipsHueCentral::getPeer(uint64_t id) {
 
 std::shared_ptr<PhilipsHuePeer> PhilipsHueCentral::getPeer(std::string serialNumber) {
   try {
-    std::lock_guard<std::mutex> peersGuard(_peersMutex);
-    if (_peersBySerial.find(serialNumber) != _peersBySerial.end()) return std::dynamic_pointer_cast<PhilipsHuePeer>(_peersBySerial.at(serialNumber));
+    std::shared_ptr<const PeerIndex> peerIndex = std::atomic_load(&_peerIndex);
+    auto peerIterator = peerIndex->bySerial.find(serialNumber);
+    if (peerIterator != peerIndex->bySerial.end()) return peerIterator->second;
   }
   catch (const std::exception &ex) {
     GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
@@ -253,6 +402,57 @@ std::shared_ptr<PhilipsHuePeer> PhilipsHueCentral::getPeer(std::string serialNum
   return std::shared_ptr<PhilipsHuePeer>();
 }
 
+void PhilipsHueCentral::addPeers(const std::vector<std::shared_ptr<PhilipsHuePeer>> &peers) {
+  try {
+    if (peers.empty()) return;
+    std::lock_guard<std::mutex> peersGuard(_peersMutex);
+    for (auto &peer : peers) {
+      if (!peer->isTeam()) _peers[peer->getAddress()] = peer;
+      if (!peer->getSerialNumber().empty()) _peersBySerial[peer->getSerialNumber()] = peer;
+      _peersById[peer->getID()] = peer;
+    }
+    rebuildPeerIndex();
+  }
+  catch (const std::exception &ex) {
+    GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void PhilipsHueCentral::removePeer(const std::shared_ptr<PhilipsHuePeer> &peer) {
+  try {
+    std::lock_guard<std::mutex> peersGuard(_peersMutex);
+    _peersBySerial.erase(peer->getSerialNumber());
+    _peersById.erase(peer->getID());
+    if (!peer->isTeam()) _peers.erase(peer->getAddress());
+    rebuildPeerIndex();
+  }
+  catch (const std::exception &ex) {
+    GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void PhilipsHueCentral::rebuildPeerIndex() {
+  try {
+    auto peerIndex = std::make_shared<PeerIndex>();
+    for (auto &peerIterator : _peers) {
+      auto peer = std::dynamic_pointer_cast<PhilipsHuePeer>(peerIterator.second);
+      if (peer) peerIndex->byAddress.emplace(peerIterator.first, peer);
+    }
+    for (auto &peerIterator : _peersById) {
+      auto peer = std::dynamic_pointer_cast<PhilipsHuePeer>(peerIterator.second);
+      if (peer) peerIndex->byId.emplace(peerIterator.first, peer);
+    }
+    for (auto &peerIterator : _peersBySerial) {
+      auto peer = std::dynamic_pointer_cast<PhilipsHuePeer>(peerIterator.second);
+      if (peer) peerIndex->bySerial.emplace(peerIterator.first, peer);
+    }
+    std::atomic_store(&_peerIndex, std::shared_ptr<const PeerIndex>(std::move(peerIndex)));
+  }
+  catch (const std::exception &ex) {
+    GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
 void PhilipsHueCentral::deletePeer(uint64_t id) {
   try {
     std::shared_ptr<PhilipsHuePeer> peer(getPeer(id));
@@ -292,12 +492,7 @@ void PhilipsHueCentral::deletePeer(uint64_t id) {
     std::vector<uint64_t> deletedIds{id};
     raiseRPCDeleteDevices(deletedIds, deviceAddresses, deviceInfo);
 
-    {
-      std::lock_guard<std::mutex> peersGuard(_peersMutex);
-      if (_peersBySerial.find(peer->getSerialNumber()) != _peersBySerial.end()) _peersBySerial.erase(peer->getSerialNumber());
-      if (_peersById.find(id) != _peersById.end()) _peersById.erase(id);
-      if (!peer->isTeam() && _peers.find(peer->getAddress()) != _peers.end()) _peers.erase(peer->getAddress());
-    }
+    removePeer(peer);
 
     int32_t i = 0;
     while (peer.use_count() > 1 && i < 600) {
@@ -320,11 +515,16 @@ std::string PhilipsHueCentral::handleCliCommand(std::string command) {
     if (command == "help" || command == "h") {
       stringStream << "List of commands (shortcut in brackets):" << std::endl << std::endl;
       stringStream << "For more information about the individual command type: COMMAND help" << std::endl << std::endl;
+      stringStream << "bridgebenchmark (bb)\tMeasures the command throughput of a hue bridge" << std::endl;
+      stringStream << "jsonbenchmark (jb)\tCompares full and selective decoding of a bridge response" << std::endl;
+      stringStream << "lookupbenchmark (lb)\tMeasures concurrent peer lookups of poll and RPC threads" << std::endl;
+      stringStream << "metrics (me)\t\tShows latencies and error counters of all hue bridges" << std::endl;
       stringStream << "peers list (ls)\t\tList all peers" << std::endl;
       stringStream << "peers remove (prm)\tRemove a peer (without unpairing)" << std::endl;
       stringStream << "peers select (ps)\tSelect a peer" << std::endl;
       stringStream << "peers setname (pn)\tName a peer" << std::endl;
       stringStream << "search (sp)\t\tSearches for new devices" << std::endl;
+      stringStream << "statistics (st)\tShows statistics of all hue bridges" << std::endl;
       stringStream << "unselect (u)\t\tUnselect this device" << std::endl;
       return stringStream.str();
     }
@@ -584,6 +784,350 @@ std::string PhilipsHueCentral::handleCliCommand(std::string command) {
       searchDevicesThread("");
       stringStream << "Search completed. Please press the button on all newly added hue bridges." << std::endl;
       return stringStream.str();
+    } else if (command.compare(0, 10, "statistics") == 0 || command.compare(0, 2, "st") == 0) {
+      std::stringstream stream(command);
+      std::string element;
+      int32_t index = 0;
+      while (std::getline(stream, element, ' ')) {
+        if (index < 1) {
+          index++;
+          continue;
+        } else if (index == 1) {
+          if (element == "help") {
+            stringStream << "Description: This command shows statistics of all hue bridges, e. g. how many unchanged resources were not passed on to the peers, and of the persistence queue." << std::endl;
+            stringStream << "Usage: statistics" << std::endl << std::endl;
+            stringStream << "Parameters:" << std::endl;
+            stringStream << "  There are no parameters." << std::endl;
+            return stringStream.str();
+          }
+        }
+        index++;
+      }
+
+      auto interfaces = GD::interfaces->getInterfaces();
+      if (interfaces.empty()) stringStream << "No hue bridges are known." << std::endl;
+      for (auto &interface : interfaces) {
+        stringStream << interface->getID() << ":" << std::endl;
+        stringStream << interface->getStatistics()->print(false, false, true);
+      }
+      if (GD::persistenceQueue) {
+        stringStream << "Persistence queue:" << std::endl;
+        stringStream << GD::persistenceQueue->getStatistics()->print(false, false, true);
+      }
+      return stringStream.str();
+    } else if (command.compare(0, 7, "metrics") == 0 || command.compare(0, 2, "me") == 0) {
+      std::string interfaceId;
+
+      std::stringstream stream(command);
+      std::string element;
+      int32_t index = 0;
+      while (std::getline(stream, element, ' ')) {
+        if (index < 1) {
+          index++;
+          continue;
+        } else if (index == 1) {
+          if (element == "help") {
+            stringStream << "Description: This command shows latency histograms and error counters of the hue bridges. All times are in microseconds." << std::endl;
+            stringStream << "Usage: metrics [BRIDGE]" << std::endl << std::endl;
+            stringStream << "Parameters:" << std::endl;
+            stringStream << "  BRIDGE:\tThe ID of the hue bridge to show the metrics for. Optional." << std::endl;
+            return stringStream.str();
+          }
+          interfaceId = element;
+        }
+        index++;
+      }
+
+      auto metrics = collectBridgeMetrics(interfaceId);
+      if (metrics->structValue->empty()) stringStream << "No hue bridges are known." << std::endl;
+      for (auto &interfaceMetrics : *metrics->structValue) {
+        stringStream << interfaceMetrics.first << ":" << std::endl;
+        stringStream << interfaceMetrics.second->print(false, false, true);
+      }
+      return stringStream.str();
+    } else if (command.compare(0, 13, "jsonbenchmark") == 0 || command.compare(0, 2, "jb") == 0) {
+      std::string filename;
+      int32_t iterations = 100;
+
+      std::stringstream stream(command);
+      std::string element;
+      int32_t index = 0;
+      while (std::getline(stream, element, ' ')) {
+        if (index < 1) {
+          index++;
+          continue;
+        } else if (index == 1) {
+          if (element == "help") break;
+          filename = element;
+        } else if (index == 2) {
+          iterations = BaseLib::Math::getNumber(element);
+          if (iterations < 1) iterations = 1;
+        }
+        index++;
+      }
+      if (index == 1) {
+        stringStream << "Description: This command decodes a recorded response of \"GET /api/<username>\" completely and selectively (only the members needed for polling) and prints the time and the number of created variables per decode." << std::endl;
+        stringStream << "Usage: jsonbenchmark FILE [ITERATIONS]" << std::endl << std::endl;
+        stringStream << "Parameters:" << std::endl;
+        stringStream << "  FILE:\t\tThe file containing the bridge response. Example: /tmp/hue.json" << std::endl;
+        stringStream << "  ITERATIONS:\tThe number of decodes to run. Default: 100" << std::endl;
+        return stringStream.str();
+      }
+
+      if (!BaseLib::Io::fileExists(filename)) {
+        stringStream << "File not found." << std::endl;
+        return stringStream.str();
+      }
+      std::string json = BaseLib::Io::getFileContent(filename);
+
+      std::function<int64_t(const PVariable &)> countVariables = [&countVariables](const PVariable &variable) -> int64_t {
+        if (!variable) return 0;
+        int64_t count = 1;
+        for (auto &element : *variable->arrayValue) {
+          count += countVariables(element);
+        }
+        for (auto &element : *variable->structValue) {
+          count += countVariables(element.second);
+        }
+        return count;
+      };
+
+      BaseLib::Rpc::JsonDecoder decoder(GD::bl);
+      const std::vector<std::string> members{"lights", "groups"};
+      int64_t fullVariables = 0;
+      int64_t selectiveVariables = 0;
+
+      auto startTime = std::chrono::steady_clock::now();
+      for (int32_t i = 0; i < iterations; i++) {
+        fullVariables = countVariables(decoder.decode(json));
+      }
+      auto fullTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+      startTime = std::chrono::steady_clock::now();
+      for (int32_t i = 0; i < iterations; i++) {
+        PVariable result = JsonMemberScanner::decodeMembers(decoder, json, members);
+        if (!result) {
+          stringStream << "File does not contain a JSON object." << std::endl;
+          return stringStream.str();
+        }
+        selectiveVariables = countVariables(result);
+      }
+      auto selectiveTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+      stringStream << "Document size: " << json.size() << " bytes" << std::endl;
+      stringStream << "Full decode:      " << std::setw(10) << (fullTime / iterations) << " us, " << std::setw(8) << fullVariables << " variables" << std::endl;
+      stringStream << "Selective decode: " << std::setw(10) << (selectiveTime / iterations) << " us, " << std::setw(8) << selectiveVariables << " variables" << std::endl;
+      return stringStream.str();
+    } else if (command.compare(0, 15, "lookupbenchmark") == 0 || command.compare(0, 2, "lb") == 0) {
+      int32_t pollThreads = 4;
+      int32_t rpcThreads = 4;
+      int32_t duration = 1000;
+
+      std::stringstream stream(command);
+      std::string element;
+      int32_t index = 0;
+      bool help = false;
+      while (std::getline(stream, element, ' ')) {
+        if (index < 1) {
+          index++;
+          continue;
+        } else if (element == "help") {
+          help = true;
+          break;
+        } else if (index == 1) {
+          pollThreads = BaseLib::Math::getNumber(element);
+          if (pollThreads < 0) pollThreads = 0;
+        } else if (index == 2) {
+          rpcThreads = BaseLib::Math::getNumber(element);
+          if (rpcThreads < 0) rpcThreads = 0;
+        } else if (index == 3) {
+          duration = BaseLib::Math::getNumber(element);
+          if (duration < 1) duration = 1;
+        }
+        index++;
+      }
+      if (help) {
+        stringStream << "Description: This command looks up the paired peers from concurrent threads and prints the lookups per second. Poll threads look up all lights and groups by address like incoming packets do. RPC threads look up peers by ID and their teams by serial number like setValue does. Each run is done with the peer index and with the locked peer maps of the central for comparison." << std::endl;
+        stringStream << "Usage: lookupbenchmark [POLLTHREADS] [RPCTHREADS] [DURATION]" << std::endl << std::endl;
+        stringStream << "Parameters:" << std::endl;
+        stringStream << "  POLLTHREADS:\tThe number of threads looking up peers by address. Default: 4" << std::endl;
+        stringStream << "  RPCTHREADS:\tThe number of threads looking up peers by ID and serial number. Default: 4" << std::endl;
+        stringStream << "  DURATION:\tThe duration of each run in milliseconds. Default: 1000" << std::endl;
+        return stringStream.str();
+      }
+
+      std::vector<int32_t> addresses;
+      std::vector<std::pair<uint64_t, std::string>> rpcPeers;
+      {
+        std::shared_ptr<const PeerIndex> peerIndex = std::atomic_load(&_peerIndex);
+        for (auto &peerIterator : peerIndex->byAddress) {
+          addresses.push_back(peerIterator.first);
+        }
+        for (auto &peerIterator : peerIndex->byId) {
+          rpcPeers.emplace_back(peerIterator.first, peerIterator.second->hasTeam() ? peerIterator.second->getTeamSerialNumber() : peerIterator.second->getSerialNumber());
+        }
+      }
+      if (addresses.empty() || rpcPeers.empty()) {
+        stringStream << "No peers are paired to this central." << std::endl;
+        return stringStream.str();
+      }
+
+      //Returns the lookups per second of the poll and the RPC threads.
+      auto run = [&](bool locked) -> std::pair<double, double> {
+        std::atomic_bool stop{false};
+        std::atomic<int64_t> pollLookups{0};
+        std::atomic<int64_t> rpcLookups{0};
+        auto lookUpAddress = [&](int32_t address) -> std::shared_ptr<PhilipsHuePeer> {
+          if (!locked) return getPeer(address);
+          std::lock_guard<std::mutex> peersGuard(_peersMutex);
+          if (_peers.find(address) != _peers.end()) return std::dynamic_pointer_cast<PhilipsHuePeer>(_peers.at(address));
+          return std::shared_ptr<PhilipsHuePeer>();
+        };
+        auto lookUpId = [&](uint64_t id) -> std::shared_ptr<PhilipsHuePeer> {
+          if (!locked) return getPeer(id);
+          std::lock_guard<std::mutex> peersGuard(_peersMutex);
+          if (_peersById.find(id) != _peersById.end()) return std::dynamic_pointer_cast<PhilipsHuePeer>(_peersById.at(id));
+          return std::shared_ptr<PhilipsHuePeer>();
+        };
+        auto lookUpSerial = [&](const std::string &serialNumber) -> std::shared_ptr<PhilipsHuePeer> {
+          if (!locked) return getPeer(serialNumber);
+          std::lock_guard<std::mutex> peersGuard(_peersMutex);
+          if (_peersBySerial.find(serialNumber) != _peersBySerial.end()) return std::dynamic_pointer_cast<PhilipsHuePeer>(_peersBySerial.at(serialNumber));
+          return std::shared_ptr<PhilipsHuePeer>();
+        };
+
+        std::vector<std::thread> threads;
+        for (int32_t i = 0; i < pollThreads; i++) {
+          threads.emplace_back([&]() {
+            int64_t lookups = 0;
+            while (!stop) {
+              for (auto address : addresses) {
+                if (lookUpAddress(address)) lookups++;
+              }
+            }
+            pollLookups += lookups;
+          });
+        }
+        for (int32_t i = 0; i < rpcThreads; i++) {
+          threads.emplace_back([&]() {
+            int64_t lookups = 0;
+            while (!stop) {
+              for (auto &rpcPeer : rpcPeers) {
+                if (lookUpId(rpcPeer.first)) lookups++;
+                if (lookUpSerial(rpcPeer.second)) lookups++;
+              }
+            }
+            rpcLookups += lookups;
+          });
+        }
+        auto startTime = std::chrono::steady_clock::now();
+        std::this_thread::sleep_for(std::chrono::milliseconds(duration));
+        stop = true;
+        for (auto &thread : threads) {
+          thread.join();
+        }
+        double seconds = (double)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count() / 1000000.0;
+        return std::make_pair((double)pollLookups / seconds, (double)rpcLookups / seconds);
+      };
+
+      auto indexResult = run(false);
+      auto lockedResult = run(true);
+
+      stringStream << "Peers:        " << rpcPeers.size() << " (" << addresses.size() << " by address)" << std::endl;
+      stringStream << "Threads:      " << pollThreads << " poll, " << rpcThreads << " RPC" << std::endl;
+      stringStream << std::fixed << std::setprecision(0);
+      stringStream << "Peer index:   " << std::setw(12) << indexResult.first << " poll lookups/s, " << std::setw(12) << indexResult.second << " RPC lookups/s" << std::endl;
+      stringStream << "Locked maps:  " << std::setw(12) << lockedResult.first << " poll lookups/s, " << std::setw(12) << lockedResult.second << " RPC lookups/s" << std::endl;
+      return stringStream.str();
+    } else if (command.compare(0, 15, "bridgebenchmark") == 0 || command.compare(0, 2, "bb") == 0) {
+      std::string interfaceId;
+      int32_t commandCount = 100;
+      int32_t concurrency = 1;
+
+      std::stringstream stream(command);
+      std::string element;
+      int32_t index = 0;
+      while (std::getline(stream, element, ' ')) {
+        if (index < 1) {
+          index++;
+          continue;
+        } else if (index == 1) {
+          if (element == "help") break;
+          interfaceId = element;
+        } else if (index == 2) {
+          commandCount = BaseLib::Math::getNumber(element);
+          if (commandCount < 1) commandCount = 1;
+        } else if (index == 3) {
+          concurrency = BaseLib::Math::getNumber(element);
+          if (concurrency < 1) concurrency = 1;
+        }
+        index++;
+      }
+      if (index == 1) {
+        stringStream << "Description: This command sends light commands to a hue bridge as fast as possible and prints the throughput and the metrics of the bridge. Use it together with the hue emulator (tools/HueEmulator.cpp) to benchmark the network code without real hardware. All lights of the bridge are switched on." << std::endl;
+        stringStream << "Usage: bridgebenchmark BRIDGE [COMMANDS] [CONCURRENCY]" << std::endl << std::endl;
+        stringStream << "Parameters:" << std::endl;
+        stringStream << "  BRIDGE:\tThe ID of the hue bridge." << std::endl;
+        stringStream << "  COMMANDS:\tThe number of commands to send. Default: 100" << std::endl;
+        stringStream << "  CONCURRENCY:\tThe maximum number of commands waiting for a response. Limited to the number of lights. Default: 1" << std::endl;
+        return stringStream.str();
+      }
+
+      std::shared_ptr<IPhilipsHueInterface> interface;
+      for (auto &bridge : GD::interfaces->getInterfaces()) {
+        if (bridge->getID() == interfaceId) interface = bridge;
+      }
+      if (!interface) {
+        stringStream << "Unknown hue bridge." << std::endl;
+        return stringStream.str();
+      }
+
+      std::vector<int32_t> lights;
+      {
+        std::shared_ptr<const PeerIndex> peerIndex = std::atomic_load(&_peerIndex);
+        for (auto &peerIterator : peerIndex->byId) {
+          auto &peer = peerIterator.second;
+          if (peer->isTeam() || peer->getPhysicalInterfaceId() != interfaceId || (peer->getAddress() & HUE_SENSOR_ADDRESS_OFFSET)) continue;
+          lights.push_back(peer->getAddress());
+        }
+      }
+      if (lights.empty()) {
+        stringStream << "The hue bridge has no lights." << std::endl;
+        return stringStream.str();
+      }
+      //Commands to a light still waiting in the queue are merged, so there must not be more pending commands than lights.
+      if (concurrency > (int32_t)lights.size()) concurrency = (int32_t)lights.size();
+
+      std::deque<std::future<bool>> pendingResults;
+      int32_t succeeded = 0;
+      int32_t failed = 0;
+      auto startTime = std::chrono::steady_clock::now();
+      for (int32_t i = 0; i < commandCount; i++) {
+        if ((int32_t)pendingResults.size() >= concurrency) {
+          if (pendingResults.front().get()) succeeded++;
+          else failed++;
+          pendingResults.pop_front();
+        }
+        auto json = std::make_shared<Variable>(VariableType::tStruct);
+        json->structValue->emplace("on", std::make_shared<Variable>(true));
+        json->structValue->emplace("bri", std::make_shared<Variable>(1 + (i % 254)));
+        auto packet = std::make_shared<PhilipsHuePacket>(PhilipsHuePacket::Category::light, getAddress(), lights.at(i % lights.size()), 2, json);
+        pendingResults.push_back(interface->queuePacket(packet, IPhilipsHueInterface::CommandPriority::bulk));
+      }
+      for (auto &result : pendingResults) {
+        if (result.get()) succeeded++;
+        else failed++;
+      }
+      auto duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+      stringStream << "Lights:      " << lights.size() << std::endl;
+      stringStream << "Commands:    " << commandCount << " (" << succeeded << " succeeded, " << failed << " failed)" << std::endl;
+      stringStream << "Concurrency: " << concurrency << std::endl;
+      stringStream << "Duration:    " << (duration / 1000) << " ms" << std::endl;
+      stringStream << "Throughput:  " << std::fixed << std::setprecision(1) << ((double)commandCount * 1000000.0 / (double)std::max((int64_t)1, (int64_t)duration)) << " commands/s" << std::endl << std::endl;
+      stringStream << "Metrics of the bridge since the start of Homegear (times in microseconds):" << std::endl;
+      stringStream << interface->getMetrics()->print(false, false, true);
+      return stringStream.str();
     } else return "Unknown command.\n";
   }
   catch (const std::exception &ex) {
@@ -764,11 +1308,7 @@ std::vector<std::shared_ptr<PhilipsHuePeer>> PhilipsHueCentral::searchTeams(bool
               if (name != info->structValue->end()) team->setName(name->second->stringValue);
               team->initializeCentralConfig();
 
-              {
-                std::lock_guard<std::mutex> peersGuard(_peersMutex);
-                _peersBySerial[team->getSerialNumber()] = team;
-                _peersById[team->getID()] = team;
-              }
+              addPeers({team});
 
               auto peers = info->structValue->find("lights");
               if (peers != info->structValue->end()) {
@@ -874,12 +1414,7 @@ void PhilipsHueCentral::searchDevicesThread(std::string interfaceId) {
           peer->initializeCentralConfig();
           if (info->structValue->find("name") != info->structValue->end()) peer->setName(info->structValue->at("name")->stringValue);
 
-          {
-            std::lock_guard<std::mutex> peersGuard(_peersMutex);
-            _peers[peer->getAddress()] = peer;
-            if (!peer->getSerialNumber().empty()) _peersBySerial[peer->getSerialNumber()] = peer;
-            _peersById[peer->getID()] = peer;
-          }
+          addPeers({peer});
           newPeers.push_back(peer);
         }
       }
@@ -940,6 +1475,7 @@ void PhilipsHueCentral::worker() {
       try {
         std::this_thread::sleep_for(sleepingTime);
         if (_stopWorkerThread || _shuttingDown) return;
+        if (_batchEvents) raiseStaleEventBatches(1000);
         // Update devices (most importantly the IP address)
         if (counter > countsPer10Minutes) {
           countsPer10Minutes = 600;
@@ -960,6 +1496,21 @@ void PhilipsHueCentral::worker() {
 }
 
 //RPC functions
+PVariable PhilipsHueCentral::setId(BaseLib::PRpcClientInfo clientInfo, uint64_t oldPeerId, uint64_t newPeerId) {
+  try {
+    //Queued values are written by peer ID, so write them before the ID changes.
+    if (GD::persistenceQueue) GD::persistenceQueue->flush(true);
+    PVariable result = ICentral::setId(clientInfo, oldPeerId, newPeerId);
+    std::lock_guard<std::mutex> peersGuard(_peersMutex);
+    rebuildPeerIndex();
+    return result;
+  }
+  catch (const std::exception &ex) {
+    GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return Variable::createError(-32500, "Unknown application error.");
+}
+
 PVariable PhilipsHueCentral::deleteDevice(BaseLib::PRpcClientInfo clientInfo, std::string serialNumber, int32_t flags) {
   try {
     if (serialNumber.empty()) return Variable::createError(-2, "Unknown device.");
@@ -1074,5 +1625,173 @@ PVariable PhilipsHueCentral::searchInterfaces(BaseLib::PRpcClientInfo clientInfo
   }
   return Variable::createError(-32500, "Unknown application error.");
 }
+
+PVariable PhilipsHueCentral::collectBridgeMetrics(const std::string &interfaceId) {
+  auto metrics = std::make_shared<Variable>(VariableType::tStruct);
+  try {
+    auto interfaces = GD::interfaces->getInterfaces();
+    for (auto &interface : interfaces) {
+      if (!interfaceId.empty() && interface->getID() != interfaceId) continue;
+      metrics->structValue->emplace(interface->getID(), interface->getMetrics());
+    }
+  }
+  catch (const std::exception &ex) {
+    GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return metrics;
+}
+
+PVariable PhilipsHueCentral::getBridgeMetrics(const BaseLib::PRpcClientInfo &clientInfo, const BaseLib::PArray &parameters) {
+  try {
+    if (parameters->size() > 1) return Variable::createError(-1, "Method expects at most one parameter.");
+    std::string interfaceId;
+    if (parameters->size() == 1) {
+      if (parameters->at(0)->type != VariableType::tString) return Variable::createError(-1, "Parameter is not of type String.");
+      interfaceId = parameters->at(0)->stringValue;
+    }
+    return collectBridgeMetrics(interfaceId);
+  }
+  catch (const std::exception &ex) {
+    GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return Variable::createError(-32500, "Unknown application error.");
+}
+
+PVariable PhilipsHueCentral::setValues(const BaseLib::PRpcClientInfo &clientInfo, const BaseLib::PArray &parameters) {
+  try {
+    if (parameters->size() != 1) return Variable::createError(-1, "Method expects exactly one parameter.");
+    if (parameters->at(0)->type != VariableType::tArray) return Variable::createError(-1, "Parameter is not of type Array.");
+
+    struct BatchEntry {
+      size_t index = 0;
+      std::shared_ptr<PhilipsHuePeer> peer;
+      std::map<int32_t, PVariable> frames;
+    };
+
+    auto &changes = *parameters->at(0)->arrayValue;
+    auto results = std::make_shared<Variable>(VariableType::tArray);
+    results->arrayValue->resize(changes.size());
+
+    //Changes resulting in identical frames on the same bridge are candidates for one group command.
+    BaseLib::Rpc::JsonEncoder jsonEncoder(GD::bl);
+    std::map<std::string, std::map<std::string, std::vector<BatchEntry>>> batches;
+    for (size_t i = 0; i < changes.size(); i++) {
+      auto &change = changes.at(i);
+      if (change->type != VariableType::tStruct) {
+        results->arrayValue->at(i) = Variable::createError(-1, "Entry is not of type Struct.");
+        continue;
+      }
+
+      auto peerIdIterator = change->structValue->find("PEER_ID");
+      auto channelIterator = change->structValue->find("CHANNEL");
+      auto valuesIterator = change->structValue->find("VALUES");
+      if (peerIdIterator == change->structValue->end() || valuesIterator == change->structValue->end() || valuesIterator->second->type != VariableType::tStruct) {
+        results->arrayValue->at(i) = Variable::createError(-1, "Entry needs the elements \"PEER_ID\" and \"VALUES\".");
+        continue;
+      }
+      int32_t channel = channelIterator == change->structValue->end() ? 1 : channelIterator->second->integerValue;
+
+      BatchEntry entry;
+      entry.index = i;
+      entry.peer = getPeer((uint64_t)peerIdIterator->second->integerValue64);
+      if (!entry.peer) {
+        results->arrayValue->at(i) = Variable::createError(-2, "Unknown device.");
+        continue;
+      }
+
+      PVariable result = entry.peer->collectValues(clientInfo, channel, valuesIterator->second, true, entry.frames);
+      results->arrayValue->at(i) = result;
+      if (result->errorStruct || entry.frames.empty()) continue;
+
+      std::string key;
+      for (auto &frame : entry.frames) {
+        std::string json;
+        jsonEncoder.encode(frame.second, json);
+        key.append(std::to_string(frame.first) + ":" + json + "\n");
+      }
+      batches[entry.peer->getPhysicalInterfaceId()][key].emplace_back(std::move(entry));
+    }
+
+    BaseLib::PRpcClientInfo callerInfo = clientInfo;
+    IPhilipsHueInterface::CommandPriority priority = (clientInfo && (clientInfo->scriptEngineServer || clientInfo->flowsServer)) ? IPhilipsHueInterface::CommandPriority::bulk : IPhilipsHueInterface::CommandPriority::interactive;
+    for (auto &interfaceBatches : batches) {
+      std::vector<std::shared_ptr<PhilipsHuePeer>> teams;
+      std::set<uint64_t> lights;
+      {
+        std::shared_ptr<const PeerIndex> peerIndex = std::atomic_load(&_peerIndex);
+        for (auto &peerIterator : peerIndex->byId) {
+          auto &peer = peerIterator.second;
+          if (peer->getPhysicalInterfaceId() != interfaceBatches.first) continue;
+          if (peer->isTeam()) teams.push_back(peer);
+          else if (!(peer->getAddress() & HUE_SENSOR_ADDRESS_OFFSET)) lights.insert(peer->getID());
+        }
+      }
+
+      for (auto &batch : interfaceBatches.second) {
+        auto &entries = batch.second;
+        std::set<uint64_t> peerIds;
+        for (auto &entry : entries) {
+          if (entry.peer->isTeam() || (entry.peer->getAddress() & HUE_SENSOR_ADDRESS_OFFSET)) break;
+          peerIds.insert(entry.peer->getID());
+        }
+
+        PVariable result;
+        if (entries.size() > 1 && peerIds.size() == entries.size()) {
+          std::shared_ptr<PhilipsHuePeer> team;
+          for (auto &teamPeer : teams) {
+            if (teamPeer->getTeamPeers() == peerIds) {
+              team = teamPeer;
+              break;
+            }
+          }
+
+          if (team) {
+            GD::out.printInfo("Info: Sending values of " + std::to_string(peerIds.size()) + " lights to group " + team->getSerialNumber() + ".");
+            for (auto &frame : entries.front().frames) {
+              result = team->sendFrame(callerInfo, frame.first, frame.second, true);
+              if (result->errorStruct) break;
+            }
+          } else if (peerIds == lights) {
+            //Group 0 always contains all lights of a bridge.
+            GD::out.printInfo("Info: Sending values of " + std::to_string(peerIds.size()) + " lights to group 0.");
+            auto &interface = entries.front().peer->getPhysicalInterface();
+            for (auto &frame : entries.front().frames) {
+              auto packet = std::make_shared<PhilipsHuePacket>(PhilipsHuePacket::Category::group, getAddress(), (int32_t)(entries.front().peer->getInterfaceAddress() << 20), frame.first, frame.second);
+              if (!sendPacket(interface, packet, true, priority)) {
+                result = Variable::createError(-32500, "Could not send command to Hue Bridge.");
+                break;
+              }
+            }
+            //The lights must not be switched individually anymore.
+            if (!result) result = std::make_shared<Variable>(VariableType::tVoid);
+          }
+        }
+
+        if (result) {
+          if (result->errorStruct) {
+            for (auto &entry : entries) results->arrayValue->at(entry.index) = result;
+          }
+          continue;
+        }
+
+        for (auto &entry : entries) {
+          for (auto &frame : entry.frames) {
+            result = entry.peer->sendFrame(callerInfo, frame.first, frame.second, true);
+            if (result->errorStruct) {
+              results->arrayValue->at(entry.index) = result;
+              break;
+            }
+          }
+        }
+      }
+    }
+
+    return results;
+  }
+  catch (const std::exception &ex) {
+    GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return Variable::createError(-32500, "Unknown application error.");
+}
 //End RPC functions
 }
@@ -33,12 +33,13 @@
 #include <homegear-base/BaseLib.h>
 #include "PhilipsHuePeer.h"
 #include "PhilipsHuePacket.h"
-#include "PacketManager.h"
 #include "PhilipsHueDeviceTypes.h"
 
+#include <map>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <unordered_map>
 
 namespace PhilipsHue
 {
@@ -64,9 +65,23 @@ public:
 	virtual void homegearShuttingDown();
 
 	virtual bool onPacketReceived(std::string& senderID, std::shared_ptr<BaseLib::Systems::Packet> packet);
+
+	/**
+	 * Events raised by peers while they process a packet are collected per bridge when "batchEvents" is enabled. All other events are
+	 * passed on immediately.
+	 */
+	virtual void onEvent(std::string& source, uint64_t peerId, int32_t channel, std::shared_ptr<std::vector<std::string>>& variables, std::shared_ptr<std::vector<BaseLib::PVariable>>& values);
+	virtual void onRPCEvent(std::string& source, uint64_t peerId, int32_t channel, std::string& deviceAddress, std::shared_ptr<std::vector<std::string>>& valueKeys, std::shared_ptr<std::vector<BaseLib::PVariable>>& values);
 	virtual std::string handleCliCommand(std::string command);
 	virtual uint64_t getPeerIdFromSerial(std::string& serialNumber) { std::shared_ptr<PhilipsHuePeer> peer = getPeer(serialNumber); if(peer) return peer->getID(); else return 0; }
-	virtual void sendPacket(std::shared_ptr<IPhilipsHueInterface>& interface, std::shared_ptr<PhilipsHuePacket> packet);
+	/**
+	 * Queues a packet on the given interface.
+	 *
+	 * @param wait When "true", the method blocks until the packet was sent.
+	 * @param priority The priority lane to queue the packet in.
+	 * @return Returns "false" when the packet couldn't be queued or - with "wait" set - wasn't sent successfully.
+	 */
+	virtual bool sendPacket(std::shared_ptr<IPhilipsHueInterface>& interface, std::shared_ptr<PhilipsHuePacket> packet, bool wait = false, IPhilipsHueInterface::CommandPriority priority = IPhilipsHueInterface::CommandPriority::interactive);
 	uint32_t getDeviceType(const std::string& manufacturer, const std::string& modelId, const std::string &type, PhilipsHuePacket::Category category);
 
 	std::shared_ptr<PhilipsHuePeer> getPeer(int32_t address);
@@ -75,21 +90,85 @@ public:
 
 	virtual PVariable deleteDevice(BaseLib::PRpcClientInfo clientInfo, std::string serialNumber, int32_t flags);
 	virtual PVariable deleteDevice(BaseLib::PRpcClientInfo clientInfo, uint64_t peerID, int32_t flags);
+
+	/**
+	 * ICentral changes the peer maps directly, so the peer index is rebuilt afterwards.
+	 */
+	virtual PVariable setId(BaseLib::PRpcClientInfo clientInfo, uint64_t oldPeerId, uint64_t newPeerId);
     virtual PVariable getPairingState(BaseLib::PRpcClientInfo clientInfo);
 	virtual PVariable searchDevices(BaseLib::PRpcClientInfo clientInfo, const std::string& interfaceId);
 	virtual PVariable searchInterfaces(BaseLib::PRpcClientInfo clientInfo, BaseLib::PVariable metadata);
+
+	/**
+	 * Returns the metrics of the hue bridges (see IPhilipsHueInterface::getMetrics()).
+	 *
+	 * @param parameters Optionally the ID of the bridge to return the metrics for.
+	 * @return Returns a struct with the bridge IDs as keys.
+	 */
+	PVariable getBridgeMetrics(const BaseLib::PRpcClientInfo& clientInfo, const BaseLib::PArray& parameters);
+
+	/**
+	 * Sets the values of multiple peers at once. Lights receiving identical values are switched with one group command when they
+	 * form exactly the member set of a group or all lights of a bridge (group 0).
+	 *
+	 * @param parameters One array of structs with the elements "PEER_ID", "CHANNEL" (default 1) and "VALUES" (struct as passed to putParamset).
+	 * @return Returns an array with the result of each entry.
+	 */
+	PVariable setValues(const BaseLib::PRpcClientInfo& clientInfo, const BaseLib::PArray& parameters);
 protected:
 	//In table variables
 	int32_t _firmwareVersion = 0;
 	//End
 
-	std::map<std::string, std::shared_ptr<PacketManager>> _sentPackets;
-
 	std::atomic_bool _shuttingDown;
 
 	std::atomic_bool _stopWorkerThread;
 	std::thread _workerThread;
 
+	struct BatchedValues
+	{
+		std::vector<std::string> keys;
+		std::vector<PVariable> values;
+
+		void set(const std::string& key, const PVariable& value);
+	};
+
+	struct BatchedChannel
+	{
+		std::string source;
+		std::string address;
+		BatchedValues events;
+		BatchedValues rpcEvents;
+	};
+
+	struct EventBatch
+	{
+		int64_t startTime = 0;
+		std::map<std::pair<uint64_t, int32_t>, BatchedChannel> channels;
+	};
+
+	bool _batchEvents = false;
+	bool _raiseBatchedPeerEvents = true;
+	std::mutex _eventBatchesMutex;
+	std::unordered_map<std::string, EventBatch> _eventBatches;
+
+	/**
+	 * The ID of the interface whose packet is processed by the current thread or nullptr.
+	 */
+	static thread_local const std::string* _batchInterfaceId;
+
+	/**
+	 * Typed copy of the peer maps of ICentral, so lookups need neither "_peersMutex" nor a cast. A published index is never modified:
+	 * After every change of the peer maps, rebuildPeerIndex() creates a new index and replaces the old one with std::atomic_store.
+	 */
+	struct PeerIndex
+	{
+		std::unordered_map<int32_t, std::shared_ptr<PhilipsHuePeer>> byAddress;
+		std::unordered_map<uint64_t, std::shared_ptr<PhilipsHuePeer>> byId;
+		std::unordered_map<std::string, std::shared_ptr<PhilipsHuePeer>> bySerial;
+	};
+	std::shared_ptr<const PeerIndex> _peerIndex;
+
 	std::mutex _peerInitMutex;
 	std::mutex _searchHueBridgesMutex;
 	std::atomic_bool _searching;
@@ -109,10 +188,33 @@ protected:
 	std::shared_ptr<PhilipsHuePeer> createPeer(int32_t address, int32_t firmwareVersion, uint32_t deviceType, std::string serialNumber, std::shared_ptr<IPhilipsHueInterface> interface, bool save = true);
 	std::shared_ptr<PhilipsHuePeer> createTeam(int32_t address, std::string serialNumber, std::shared_ptr<IPhilipsHueInterface> interface, bool save);
 	void deletePeer(uint64_t id);
+
+	/**
+	 * Adds peers to the peer maps and the peer index. Teams are not added by address.
+	 */
+	void addPeers(const std::vector<std::shared_ptr<PhilipsHuePeer>>& peers);
+	void removePeer(const std::shared_ptr<PhilipsHuePeer>& peer);
+
+	/**
+	 * Creates a new peer index from the peer maps of ICentral. Must be called with "_peersMutex" locked after every change of the maps.
+	 */
+	void rebuildPeerIndex();
 	void searchDevicesThread(std::string interfaceId);
 	std::vector<std::shared_ptr<PhilipsHuePeer>> searchTeams(bool findNew = true);
+	PVariable collectBridgeMetrics(const std::string& interfaceId);
 	void searchHueBridges(bool removeNotFound = true);
 
+	/**
+	 * Raises the events collected for a bridge as one "EVENT_BATCH" event of the central and - with "batchedPeerEvents" enabled - one
+	 * merged event per peer channel.
+	 */
+	void raiseEventBatch(const std::string& interfaceId);
+
+	/**
+	 * Raises all batches older than "maxAge" milliseconds. Batches normally end with the batch end packet of the bridge.
+	 */
+	void raiseStaleEventBatches(int64_t maxAge);
+
 	void init();
 	void worker();
 };
@@ -215,6 +215,35 @@ void PhilipsHuePeer::saveVariables()
     }
 }
 
+void PhilipsHuePeer::saveParameterData(BaseLib::Systems::RpcConfigurationParameter& parameter, uint32_t channel, const std::string& name, std::vector<uint8_t>& data)
+{
+	try
+	{
+		//New parameters are written immediately, because their database ID is needed.
+		if(parameter.databaseId == 0) saveParameter(0, ParameterGroup::Type::Enum::variables, channel, name, data);
+		else if(!GD::persistenceQueue || !GD::persistenceQueue->enqueue(_peerID, parameter.databaseId, GD::persistenceQueue->getPolicy(name), data)) saveParameter(parameter.databaseId, data);
+	}
+	catch(const std::exception& ex)
+    {
+    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+}
+
+void PhilipsHuePeer::saveParameters(std::vector<std::pair<uint64_t, std::vector<uint8_t>>>& rows)
+{
+	try
+	{
+		for(auto& row : rows)
+		{
+			saveParameter(row.first, row.second);
+		}
+	}
+	catch(const std::exception& ex)
+    {
+    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+}
+
 std::vector<uint8_t> PhilipsHuePeer::serializeTeamPeers()
 {
 	std::vector<uint8_t> serializedData;
@@ -301,87 +330,89 @@ void PhilipsHuePeer::getValuesFromPacket(std::shared_ptr<PhilipsHuePacket> packe
 	try
 	{
 		if(!_rpcDevice) return;
-		//equal_range returns all elements with "0" or an unknown element as argument
-		if(_rpcDevice->packetsByMessageType.find(packet->getMessageType()) == _rpcDevice->packetsByMessageType.end()) return;
-		std::pair<PacketsByMessageType::iterator, PacketsByMessageType::iterator> range = _rpcDevice->packetsByMessageType.equal_range((uint32_t)packet->getMessageType());
-		if(range.first == _rpcDevice->packetsByMessageType.end()) return;
-		PacketsByMessageType::iterator i = range.first;
-		do
+		if(!_packetBindings || _packetBindings->device() != _rpcDevice.get()) _packetBindings = PacketBindings::get(_rpcDevice);
+		if(!_packetBindings) return;
+		PVariable json = packet->getJson();
+		if(!json) return;
+
+		for(const FrameBinding& frameBinding : _packetBindings->frames(packet->getMessageType()))
 		{
-			FrameValues currentFrameValues;
-			PPacket frame(i->second);
-			if(!frame) continue;
+			const PPacket& frame = frameBinding.frame;
 			if(frame->direction == BaseLib::DeviceDescription::Packet::Direction::Enum::toCentral && packet->senderAddress() != _address) continue;
 			if(frame->direction == BaseLib::DeviceDescription::Packet::Direction::Enum::fromCentral && packet->destinationAddress() != _address) continue;
-			int32_t channel = -1;
-			if(frame->channel > -1) channel = frame->channel;
-			currentFrameValues.frameID = frame->id;
 
-			for(JsonPayloads::iterator j = frame->jsonPayloads.begin(); j != frame->jsonPayloads.end(); ++j)
+			FrameValues currentFrameValues;
+			const PVariable* keyValue = nullptr;
+			for(const ParameterBinding& binding : frameBinding.parameters)
 			{
-				PVariable json = packet->getJson();
-				if(!json) continue;
-				if(json->structValue->find((*j)->key) == json->structValue->end()) continue;
-				json = json->structValue->operator []((*j)->key);
-				if(!(*j)->subkey.empty())
+				if(!binding.sameKeyAsPrevious)
 				{
-					if(json->structValue->find((*j)->subkey) == json->structValue->end()) continue;
-					json = json->structValue->operator[]((*j)->subkey);
+					auto keyIterator = json->structValue->find(binding.key);
+					keyValue = keyIterator == json->structValue->end() ? nullptr : &keyIterator->second;
+				}
+				if(!keyValue) continue;
+				const PVariable* value = keyValue;
+				if(!binding.subkey.empty())
+				{
+					auto subkeyIterator = (*value)->structValue->find(binding.subkey);
+					if(subkeyIterator == (*value)->structValue->end()) continue;
+					value = &subkeyIterator->second;
 				}
 
-				for(std::vector<PParameter>::iterator k = frame->associatedVariables.begin(); k != frame->associatedVariables.end(); ++k)
+				//The channels of the first value found are the channels of the frame. Later values only use channels in this set.
+				if(!currentFrameValues.paramsetChannels) currentFrameValues.paramsetChannels = &binding.channels;
+				else if(currentFrameValues.paramsetChannels != &binding.channels)
 				{
-					if((*k)->physical->groupId != (*j)->parameterId) continue;
-					currentFrameValues.parameterSetType = (*k)->parent()->type();
-					bool setValues = false;
-					if(currentFrameValues.paramsetChannels.empty()) //Fill paramsetChannels
+					bool channelFound = false;
+					for(uint32_t channel : binding.channels)
 					{
-						int32_t startChannel = (channel < 0) ? 0 : channel;
-						int32_t endChannel;
-						//When fixedChannel is -2 (means '*') cycle through all channels
-						if(frame->channel == -2)
-						{
-							startChannel = 0;
-							endChannel = _rpcDevice->functions.rbegin()->first;
-						}
-						else endChannel = startChannel;
-						for(int32_t l = startChannel; l <= endChannel; l++)
+						if(std::find(currentFrameValues.paramsetChannels->begin(), currentFrameValues.paramsetChannels->end(), channel) != currentFrameValues.paramsetChannels->end())
 						{
-							Functions::iterator functionIterator = _rpcDevice->functions.find(l);
-							if(functionIterator == _rpcDevice->functions.end()) continue;
-							PParameterGroup parameterGroup = functionIterator->second->getParameterGroup(currentFrameValues.parameterSetType);
-							if(!parameterGroup || parameterGroup->parameters.find((*k)->id) == parameterGroup->parameters.end()) continue;
-							currentFrameValues.paramsetChannels.push_back(l);
-							currentFrameValues.values[(*k)->id].channels.push_back(l);
-							setValues = true;
-						}
-					}
-					else //Use paramsetChannels
-					{
-						for(std::list<uint32_t>::const_iterator l = currentFrameValues.paramsetChannels.begin(); l != currentFrameValues.paramsetChannels.end(); ++l)
-						{
-							Functions::iterator functionIterator = _rpcDevice->functions.find(*l);
-							if(functionIterator == _rpcDevice->functions.end()) continue;
-							PParameterGroup parameterGroup = functionIterator->second->getParameterGroup(currentFrameValues.parameterSetType);
-							if(!parameterGroup || parameterGroup->parameters.find((*k)->id) == parameterGroup->parameters.end()) continue;
-							currentFrameValues.values[(*k)->id].channels.push_back(*l);
-							setValues = true;
+							channelFound = true;
+							break;
 						}
 					}
+					if(!channelFound) continue;
+				}
+
+				if(binding.isState) _state = (*value)->booleanValue;
 
-					if(setValues)
+				//Several payloads can be bound to the same parameter. The last one wins.
+				FrameValue* frameValue = nullptr;
+				for(FrameValue& existingValue : currentFrameValues.values)
+				{
+					if(existingValue.binding->parameter == binding.parameter)
 					{
-						if((*k)->id == "STATE") _state = json->booleanValue;
-						//This is a little nasty and costs a lot of resources, but we need to run the data through the packet converter
-						std::vector<uint8_t> encodedData;
-						_binaryEncoder->encodeResponse(json, encodedData);
-						PVariable data = (*k)->convertFromPacket(encodedData, Role(), true);
-						(*k)->convertToPacket(data, Role(), currentFrameValues.values[(*k)->id].value);
+						frameValue = &existingValue;
+						break;
 					}
 				}
+				if(!frameValue)
+				{
+					currentFrameValues.values.emplace_back();
+					frameValue = &currentFrameValues.values.back();
+				}
+				frameValue->binding = &binding;
+
+				PVariable packetValue = ValueConverter::fromJson(binding.conversion, binding.parameter, *value);
+				if(packetValue)
+				{
+					frameValue->value.clear();
+					_binaryEncoder->encodeResponse(packetValue, frameValue->value);
+					frameValue->rpcValue = ValueConverter::toRpc(binding.conversion, packetValue);
+				}
+				else
+				{
+					//This is a little nasty and costs a lot of resources, but we need to run the data through the packet converter
+					std::vector<uint8_t> encodedData;
+					_binaryEncoder->encodeResponse(*value, encodedData);
+					PVariable data = binding.parameter->convertFromPacket(encodedData, Role(), true);
+					binding.parameter->convertToPacket(data, Role(), frameValue->value);
+					frameValue->rpcValue.reset();
+				}
 			}
-			if(!currentFrameValues.values.empty()) frameValues.push_back(currentFrameValues);
-		} while(++i != range.second && i != _rpcDevice->packetsByMessageType.end());
+			if(!currentFrameValues.values.empty()) frameValues.push_back(std::move(currentFrameValues));
+		}
 	}
 	catch(const std::exception& ex)
     {
@@ -397,11 +428,8 @@ void PhilipsHuePeer::packetReceived(std::shared_ptr<PhilipsHuePacket> packet)
 		if(_disposing) return;
 		if(packet->senderAddress() != _address) return;
 		if(!_rpcDevice) return;
-		std::shared_ptr<PhilipsHueCentral> central = std::dynamic_pointer_cast<PhilipsHueCentral>(getCentral());
-		if(!central) return;
 		std::unique_lock<std::timed_mutex> incomingPacketGuard(_incomingPacketMutex, std::defer_lock);
 		if(!incomingPacketGuard.try_lock_for(std::chrono::milliseconds(10))) return;
-		if(_ignorePacketsUntil > BaseLib::HelperFunctions::getTime()) return;
 		setLastPacketReceived();
 		std::vector<FrameValues> frameValues;
 		getValuesFromPacket(packet, frameValues);
@@ -411,20 +439,21 @@ void PhilipsHuePeer::packetReceived(std::shared_ptr<PhilipsHuePacket> packet)
 		//Loop through all matching frames
 		for(std::vector<FrameValues>::iterator a = frameValues.begin(); a != frameValues.end(); ++a)
 		{
-			PPacket frame;
-			if(!a->frameID.empty()) frame = _rpcDevice->packetsById.at(a->frameID);
-
-			auto stateIterator = a->values.find("STATE");
-			if(stateIterator != a->values.end()) _state = (stateIterator->second.value.back() != 0);
+			for(std::vector<FrameValue>::iterator i = a->values.begin(); i != a->values.end(); ++i)
+			{
+				if(i->binding->isState && !i->value.empty()) _state = (i->value.back() != 0);
+			}
 
-			for(std::map<std::string, FrameValue>::iterator i = a->values.begin(); i != a->values.end(); ++i)
+			for(std::vector<FrameValue>::iterator i = a->values.begin(); i != a->values.end(); ++i)
 			{
-				for(std::list<uint32_t>::const_iterator j = a->paramsetChannels.begin(); j != a->paramsetChannels.end(); ++j)
+				const std::string& parameterId = i->binding->parameter->id;
+				for(std::vector<uint32_t>::const_iterator j = a->paramsetChannels->begin(); j != a->paramsetChannels->end(); ++j)
 				{
-					if(std::find(i->second.channels.begin(), i->second.channels.end(), *j) == i->second.channels.end()) continue;
+					if(std::find(i->binding->channels.begin(), i->binding->channels.end(), *j) == i->binding->channels.end()) continue;
 
-					BaseLib::Systems::RpcConfigurationParameter& parameter = valuesCentral[*j][i->first];
-					if(parameter.equals(i->second.value)) continue;
+					BaseLib::Systems::RpcConfigurationParameter& parameter = valuesCentral[*j][parameterId];
+					//Sensor packets are only raised for new events, so equal values (e. g. the same button pressed again) need to be passed on, too.
+					if(parameter.equals(i->value) && packet->getCategory() != PhilipsHuePacket::Category::sensor) continue;
 
 					if(!valueKeys[*j] || !rpcValues[*j])
 					{
@@ -432,35 +461,34 @@ void PhilipsHuePeer::packetReceived(std::shared_ptr<PhilipsHuePacket> packet)
 						rpcValues[*j].reset(new std::vector<PVariable>());
 					}
 
-					if(!_state && (i->first == "BRIGHTNESS" || i->first == "FAST_BRIGHTNESS")) continue;
+					if(!_state && (parameterId == "BRIGHTNESS" || parameterId == "FAST_BRIGHTNESS")) continue;
 
-					parameter.setBinaryData(i->second.value);
-					if(parameter.databaseId > 0) saveParameter(parameter.databaseId, i->second.value);
-					else saveParameter(0, ParameterGroup::Type::Enum::variables, *j, i->first, i->second.value);
-					if(_bl->debugLevel >= 4) GD::out.printInfo("Info: " + i->first + " of peer " + std::to_string(_peerID) + " with serial number " + _serialNumber + ":" + std::to_string(*j) + " was set to 0x" + BaseLib::HelperFunctions::getHexString(i->second.value) + ".");
+					parameter.setBinaryData(i->value);
+					saveParameterData(parameter, *j, parameterId, i->value);
+					if(_bl->debugLevel >= 4) GD::out.printInfo("Info: " + parameterId + " of peer " + std::to_string(_peerID) + " with serial number " + _serialNumber + ":" + std::to_string(*j) + " was set to 0x" + BaseLib::HelperFunctions::getHexString(i->value) + ".");
 
 					if(parameter.rpcParameter)
 					{
 						//Process service messages
-						if(parameter.rpcParameter->service && !i->second.value.empty())
+						if(parameter.rpcParameter->service && !i->value.empty())
 						{
 							if(parameter.rpcParameter->logical->type == ILogical::Type::Enum::tEnum)
 							{
-								serviceMessages->set(i->first, i->second.value.at(i->second.value.size() - 1), *j);
+								serviceMessages->set(parameterId, i->value.at(i->value.size() - 1), *j);
 							}
 							else if(parameter.rpcParameter->logical->type == ILogical::Type::Enum::tBoolean)
 							{
 								if(parameter.rpcParameter->id == "REACHABLE")
 								{
-									bool value = !((bool)i->second.value.at(i->second.value.size() - 1));
+									bool value = !((bool)i->value.at(i->value.size() - 1));
 									serviceMessages->setUnreach(value, false);
 								}
-								else serviceMessages->set(i->first, (bool)i->second.value.at(i->second.value.size() - 1));
+								else serviceMessages->set(parameterId, (bool)i->value.at(i->value.size() - 1));
 							}
 						}
 
-						valueKeys[*j]->push_back(i->first);
-						rpcValues[*j]->push_back(parameter.rpcParameter->convertFromPacket(i->second.value, parameter.mainRole(), true));
+						valueKeys[*j]->push_back(parameterId);
+						rpcValues[*j]->push_back(i->rpcValue ? i->rpcValue : parameter.rpcParameter->convertFromPacket(i->value, parameter.mainRole(), true));
 					}
 				}
 			}
@@ -491,8 +519,7 @@ void PhilipsHuePeer::packetReceived(std::shared_ptr<PhilipsHuePacket> packet)
 						parameterData.clear();
 						_binaryEncoder->encodeResponse(rpcRGB, parameterData);
 						rgbParameter.setBinaryData(parameterData);
-						if(rgbParameter.databaseId > 0) saveParameter(rgbParameter.databaseId, parameterData);
-						else saveParameter(0, ParameterGroup::Type::Enum::variables, j->first, "RGB", parameterData);
+						saveParameterData(rgbParameter, j->first, "RGB", parameterData);
 
 						j->second->push_back("RGB");
 						rpcValues[j->first]->push_back(rgbParameter.rpcParameter->convertFromPacket(parameterData, rgbParameter.mainRole(), true));
@@ -767,13 +794,15 @@ PVariable PhilipsHuePeer::putParamset(BaseLib::PRpcClientInfo clientInfo, int32_
 
 		if(type == ParameterGroup::Type::Enum::variables)
 		{
-			for(Struct::iterator i = variables->structValue->begin(); i != variables->structValue->end(); ++i)
-			{
-				if(i->first.empty() || !i->second) continue;
-
-				if(checkAcls && !clientInfo->acls->checkVariableWriteAccess(central->getPeer(_peerID), channel, i->first)) continue;
+			//All values are sent to the bridge in one request.
+			std::map<int32_t, PVariable> collectedFrames;
+			PVariable result = collectValues(clientInfo, channel, variables, checkAcls, collectedFrames);
+			if(result->errorStruct) return result;
 
-				setValue(clientInfo, channel, i->first, i->second, true);
+			for(auto& collectedFrame : collectedFrames)
+			{
+				PVariable result = sendFrame(clientInfo, collectedFrame.first, collectedFrame.second, true);
+				if(result->errorStruct) return result;
 			}
 		}
 		else
@@ -789,6 +818,34 @@ PVariable PhilipsHuePeer::putParamset(BaseLib::PRpcClientInfo clientInfo, int32_
     return Variable::createError(-32500, "Unknown application error.");
 }
 
+PVariable PhilipsHuePeer::collectValues(BaseLib::PRpcClientInfo clientInfo, int32_t channel, PVariable variables, bool checkAcls, std::map<int32_t, PVariable>& collectedFrames)
+{
+	try
+	{
+		if(_disposing) return Variable::createError(-32500, "Peer is disposing.");
+		if(channel < 0) channel = 0;
+		if(_rpcDevice->functions.find(channel) == _rpcDevice->functions.end()) return Variable::createError(-2, "Unknown channel");
+
+		auto central = getCentral();
+		if(!central) return Variable::createError(-32500, "Could not get central.");
+
+		for(Struct::iterator i = variables->structValue->begin(); i != variables->structValue->end(); ++i)
+		{
+			if(i->first.empty() || !i->second) continue;
+
+			if(checkAcls && !clientInfo->acls->checkVariableWriteAccess(central->getPeer(_peerID), channel, i->first)) continue;
+
+			setValue(clientInfo, channel, i->first, i->second, false, true, &collectedFrames);
+		}
+		return PVariable(new Variable(VariableType::tVoid));
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return Variable::createError(-32500, "Unknown application error.");
+}
+
 PVariable PhilipsHuePeer::getParamset(BaseLib::PRpcClientInfo clientInfo, int32_t channel, ParameterGroup::Type::Enum type, uint64_t remoteID, int32_t remoteChannel, bool checkAcls)
 {
 	try
@@ -843,7 +900,7 @@ PVariable PhilipsHuePeer::setValue(BaseLib::PRpcClientInfo clientInfo, uint32_t
 	return setValue(clientInfo, channel, valueKey, value, false, wait);
 }
 
-PVariable PhilipsHuePeer::setValue(BaseLib::PRpcClientInfo clientInfo, uint32_t channel, std::string valueKey, PVariable value, bool noSending, bool wait)
+PVariable PhilipsHuePeer::setValue(BaseLib::PRpcClientInfo clientInfo, uint32_t channel, std::string valueKey, PVariable value, bool noSending, bool wait, std::map<int32_t, PVariable>* collectedFrames)
 {
 	try
 	{
@@ -871,17 +928,17 @@ PVariable PhilipsHuePeer::setValue(BaseLib::PRpcClientInfo clientInfo, uint32_t
 
 			PVariable result;
 			uint8_t brightness = std::lround(hsv.getBrightness() * 255.0);
-			result = setValue(clientInfo, channel, "BRIGHTNESS", std::make_shared<Variable>((int32_t)brightness), true, wait);
+			result = setValue(clientInfo, channel, "BRIGHTNESS", std::make_shared<Variable>((int32_t)brightness), true, wait, collectedFrames);
 			if(result->errorStruct) return result;
 			int32_t hue = std::lround(hsv.getHue() * getHueFactor(hsv.getHue()));
-			result = setValue(clientInfo, channel, "HUE", std::make_shared<Variable>(hue), true, wait);
+			result = setValue(clientInfo, channel, "HUE", std::make_shared<Variable>(hue), true, wait, collectedFrames);
 			if(result->errorStruct) return result;
 			uint8_t saturation = std::lround(hsv.getSaturation() * 255.0);
-			result = setValue(clientInfo, channel, (valueKey == "RGB" ? "SATURATION" : "FAST_RGB"), std::make_shared<Variable>((int32_t)saturation), brightness < 5, wait);
+			result = setValue(clientInfo, channel, (valueKey == "RGB" ? "SATURATION" : "FAST_RGB"), std::make_shared<Variable>((int32_t)saturation), brightness < 5, wait, collectedFrames);
 			if(result->errorStruct) return result;
 			if(brightness < 5)
 			{
-				result = setValue(clientInfo, channel, "STATE", std::make_shared<Variable>(false), false, wait);
+				result = setValue(clientInfo, channel, "STATE", std::make_shared<Variable>(false), false, wait, collectedFrames);
 				if(result->errorStruct) return result;
 			}
 
@@ -890,8 +947,7 @@ PVariable PhilipsHuePeer::setValue(BaseLib::PRpcClientInfo clientInfo, uint32_t
 			std::vector<uint8_t> parameterData;
 			_binaryEncoder->encodeResponse(value, parameterData);
 			parameter.setBinaryData(parameterData);
-			if(parameter.databaseId > 0) saveParameter(parameter.databaseId, parameterData);
-			else saveParameter(0, ParameterGroup::Type::Enum::variables, channel, valueKey, parameterData);
+			saveParameterData(parameter, channel, valueKey, parameterData);
 
 			valueKeys->push_back(valueKey);
 			values->push_back(value);
@@ -903,37 +959,6 @@ PVariable PhilipsHuePeer::setValue(BaseLib::PRpcClientInfo clientInfo, uint32_t
 
 		if(valueKey == "STATE" || valueKey == "FAST_STATE")
 		{
-			{
-				std::lock_guard<std::timed_mutex> incomingPacketGuard(_incomingPacketMutex);
-				auto channelIterator = valuesCentral.find(1);
-				if(channelIterator != valuesCentral.end())
-				{
-					auto variableIterator = channelIterator->second.find("TRANSITION_TIME");
-					if(variableIterator != channelIterator->second.end())
-					{
-						std::vector<uint8_t> parameterData = variableIterator->second.getBinaryData();
-						_ignorePacketsUntil = BaseLib::HelperFunctions::getTime() + 1000 + (variableIterator->second.rpcParameter->convertFromPacket(parameterData, variableIterator->second.mainRole(), false)->integerValue * 100);
-						std::shared_ptr<PhilipsHueCentral> central = std::dynamic_pointer_cast<PhilipsHueCentral>(getCentral());
-						if(central)
-						{
-							if(_teamId != 0)
-							{
-								auto teamPeer = central->getPeer(_teamId);
-								if(teamPeer) teamPeer->setIgnorePacketsUntil(_ignorePacketsUntil);
-							}
-							std::lock_guard<std::mutex> teamPeersGuard(_teamPeersMutex);
-							if(!_teamPeers.empty())
-							{
-								for(uint64_t teamPeerId : _teamPeers)
-								{
-									auto teamPeer = central->getPeer(teamPeerId);
-									if(teamPeer) teamPeer->setIgnorePacketsUntil(_ignorePacketsUntil);
-								}
-							}
-						}
-					}
-				}
-			}
 			_state = value->booleanValue;
 			if(!_state)
 			{
@@ -945,15 +970,18 @@ PVariable PhilipsHuePeer::setValue(BaseLib::PRpcClientInfo clientInfo, uint32_t
 			}
 		}
 
+		ValueConverter::Type conversion = ValueConverter::getType(rpcParameter);
 		if(rpcParameter->physical->operationType == IPhysical::OperationType::Enum::store)
 		{
 			std::vector<uint8_t> parameterData;
-			rpcParameter->convertToPacket(value, parameter.mainRole(), parameterData);
+			PVariable packetValue = ValueConverter::fromRpc(conversion, rpcParameter, value);
+			if(packetValue) _binaryEncoder->encodeResponse(packetValue, parameterData);
+			else rpcParameter->convertToPacket(value, parameter.mainRole(), parameterData);
 			parameter.setBinaryData(parameterData);
-			if(parameter.databaseId > 0) saveParameter(parameter.databaseId, parameterData);
-			else saveParameter(0, ParameterGroup::Type::Enum::variables, channel, valueKey, parameterData);
+			saveParameterData(parameter, channel, valueKey, parameterData);
 
-			value = rpcParameter->convertFromPacket(parameterData, parameter.mainRole(), false);
+			PVariable rpcValue = ValueConverter::toRpc(conversion, packetValue);
+			value = rpcValue ? rpcValue : rpcParameter->convertFromPacket(parameterData, parameter.mainRole(), false);
 			if(rpcParameter->readable)
 			{
 				valueKeys->push_back(valueKey);
@@ -982,12 +1010,14 @@ PVariable PhilipsHuePeer::setValue(BaseLib::PRpcClientInfo clientInfo, uint32_t
         }
 
 		std::vector<uint8_t> parameterData;
-		rpcParameter->convertToPacket(value, parameter.mainRole(), parameterData);
+		PVariable packetValue = ValueConverter::fromRpc(conversion, rpcParameter, value);
+		if(packetValue) _binaryEncoder->encodeResponse(packetValue, parameterData);
+		else rpcParameter->convertToPacket(value, parameter.mainRole(), parameterData);
 		parameter.setBinaryData(parameterData);
-		if(parameter.databaseId > 0) saveParameter(parameter.databaseId, parameterData);
-		else saveParameter(0, ParameterGroup::Type::Enum::variables, channel, valueKey, parameterData);
+		saveParameterData(parameter, channel, valueKey, parameterData);
 
-		value = rpcParameter->convertFromPacket(parameterData, parameter.mainRole(), false);
+		PVariable rpcValue = ValueConverter::toRpc(conversion, packetValue);
+		value = rpcValue ? rpcValue : rpcParameter->convertFromPacket(parameterData, parameter.mainRole(), false);
 		if(_bl->debugLevel > 4) GD::out.printDebug("Debug: " + valueKey + " of peer " + std::to_string(_peerID) + " with serial number " + _serialNumber + ":" + std::to_string(channel) + " was set to " + BaseLib::HelperFunctions::getHexString(parameterData) + ", " + value->print(false, false, true) + ".");
 
 		valueKeys->push_back(valueKey);
@@ -1021,8 +1051,7 @@ PVariable PhilipsHuePeer::setValue(BaseLib::PRpcClientInfo clientInfo, uint32_t
 			{
 				BaseLib::Systems::RpcConfigurationParameter& brightnessParameter = parameterIterator->second;
 				brightnessParameter.setBinaryData(parameterData);
-				if(brightnessParameter.databaseId > 0) saveParameter(brightnessParameter.databaseId, parameterData);
-				else saveParameter(0, ParameterGroup::Type::Enum::variables, channel, brightnessKey, parameterData);
+				saveParameterData(brightnessParameter, channel, brightnessKey, parameterData);
 				valueKeys->push_back(valueKey);
 				values->push_back(value);
 				if(_bl->debugLevel > 4) GD::out.printDebug("Debug: " + brightnessKey + " of peer " + std::to_string(_peerID) + " with serial number " + _serialNumber + ":" + std::to_string(channel) + " was set to " + BaseLib::HelperFunctions::getHexString(parameterData) + ", " + value->print(false, false, true) + ".");
@@ -1069,13 +1098,18 @@ PVariable PhilipsHuePeer::setValue(BaseLib::PRpcClientInfo clientInfo, uint32_t
                     if((*i)->parameterId == rpcParameter->physical->groupId)
                     {
                         if((*i)->key.empty()) continue;
-                        std::vector<uint8_t> parameterData = parameter.getBinaryData();
-                        if((*i)->subkey.empty()) json->structValue->operator[]((*i)->key) = _binaryDecoder->decodeResponse(parameterData); //Parameter already is in packet format. Just convert it from RPC to BaseLib::Variable.
+                        PVariable jsonValue = packetValue;
+                        if(!jsonValue)
+                        {
+                            std::vector<uint8_t> parameterData = parameter.getBinaryData();
+                            jsonValue = _binaryDecoder->decodeResponse(parameterData); //Parameter already is in packet format. Just convert it from RPC to BaseLib::Variable.
+                        }
+                        if((*i)->subkey.empty()) json->structValue->operator[]((*i)->key) = jsonValue;
                         else
                         {
                             auto keyIterator = json->structValue->find((*i)->key);
                             if(keyIterator == json->structValue->end()) keyIterator = json->structValue->emplace((*i)->key, std::make_shared<Variable>(VariableType::tStruct)).first;
-                            keyIterator->second->structValue->emplace((*i)->subkey, _binaryDecoder->decodeResponse(parameterData));
+                            keyIterator->second->structValue->emplace((*i)->subkey, jsonValue);
                         }
                     }
                         //Search for all other parameters
@@ -1139,9 +1173,31 @@ PVariable PhilipsHuePeer::setValue(BaseLib::PRpcClientInfo clientInfo, uint32_t
                     }
                 }
 
-                std::shared_ptr<PhilipsHueCentral> central = std::dynamic_pointer_cast<PhilipsHueCentral>(getCentral());
-                std::shared_ptr<PhilipsHuePacket> packet(new PhilipsHuePacket((isTeam() ? PhilipsHuePacket::Category::group : PhilipsHuePacket::Category::light), central->getAddress(), _address, frame->type, json));
-                if(central) central->sendPacket(_physicalInterface, packet);
+                if(collectedFrames)
+                {
+                    //Values of later parameters replace the ones of earlier parameters.
+                    PVariable& collectedJson = (*collectedFrames)[frame->type];
+                    if(!collectedJson) collectedJson = json;
+                    else
+                    {
+                        for(auto& element : *json->structValue)
+                        {
+                            auto elementIterator = collectedJson->structValue->find(element.first);
+                            if(elementIterator != collectedJson->structValue->end() && elementIterator->second->type == VariableType::tStruct && element.second->type == VariableType::tStruct)
+                            {
+                                for(auto& subelement : *element.second->structValue)
+                                {
+                                    elementIterator->second->structValue->operator[](subelement.first) = subelement.second;
+                                }
+                            }
+                            else collectedJson->structValue->operator[](element.first) = element.second;
+                        }
+                    }
+                    continue;
+                }
+
+                PVariable result = sendFrame(clientInfo, frame->type, json, wait);
+                if(result->errorStruct) return result;
             }
 		}
 
@@ -1160,5 +1216,24 @@ PVariable PhilipsHuePeer::setValue(BaseLib::PRpcClientInfo clientInfo, uint32_t
     }
     return Variable::createError(-32500, "Unknown application error. See error log for more details.");
 }
+
+PVariable PhilipsHuePeer::sendFrame(BaseLib::PRpcClientInfo& clientInfo, int32_t type, PVariable json, bool wait)
+{
+	try
+	{
+		std::shared_ptr<PhilipsHueCentral> central = std::dynamic_pointer_cast<PhilipsHueCentral>(getCentral());
+		if(!central) return Variable::createError(-32500, "Could not get central.");
+		std::shared_ptr<PhilipsHuePacket> packet(new PhilipsHuePacket((isTeam() ? PhilipsHuePacket::Category::group : PhilipsHuePacket::Category::light), central->getAddress(), _address, type, json));
+		//Commands from scripts and flows must not delay commands of users.
+		IPhilipsHueInterface::CommandPriority priority = (clientInfo && (clientInfo->scriptEngineServer || clientInfo->flowsServer)) ? IPhilipsHueInterface::CommandPriority::bulk : IPhilipsHueInterface::CommandPriority::interactive;
+		if(!central->sendPacket(_physicalInterface, packet, wait, priority)) return Variable::createError(-32500, "Could not send command to Hue Bridge.");
+		return std::make_shared<Variable>(VariableType::tVoid);
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return Variable::createError(-32500, "Unknown application error. See error log for more details.");
+}
 //End RPC methods
 }
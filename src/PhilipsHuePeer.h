@@ -31,6 +31,7 @@
 #define PHILIPSHUEPEER_H_
 
 #include "PhilipsHuePacket.h"
+#include "PacketBindings.h"
 #include "PhysicalInterfaces/IPhilipsHueInterface.h"
 
 #include <homegear-base/BaseLib.h>
@@ -49,17 +50,16 @@ class PhilipsHueCentral;
 class FrameValue
 {
 public:
-	std::list<uint32_t> channels;
+	const ParameterBinding* binding = nullptr;
 	std::vector<uint8_t> value;
+	PVariable rpcValue; //Set when the value was converted directly, so it doesn't need to be converted back from "value".
 };
 
 class FrameValues
 {
 public:
-	std::string frameID;
-	std::list<uint32_t> paramsetChannels;
-	ParameterGroup::Type::Enum parameterSetType;
-	std::map<std::string, FrameValue> values;
+	const std::vector<uint32_t>* paramsetChannels = nullptr;
+	std::vector<FrameValue> values;
 };
 
 class PhilipsHuePeer : public BaseLib::Systems::Peer
@@ -100,7 +100,6 @@ public:
     virtual bool firmwareUpdateAvailable() { return false; }
     bool hasTeam() { return !_teamSerialNumber.empty(); }
     virtual bool isTeam() { return _serialNumber.front() == '*'; }
-    void setIgnorePacketsUntil(int64_t value) { _ignorePacketsUntil = value; }
 
 	void packetReceived(std::shared_ptr<PhilipsHuePacket> packet);
 
@@ -135,6 +134,23 @@ public:
 	 */
 	virtual PVariable setValue(BaseLib::PRpcClientInfo clientInfo, uint32_t channel, std::string valueKey, PVariable value, bool wait);
 	//End RPC methods
+
+	/**
+	 * Sets the values of a channel like putParamset, but merges the JSON of the resulting frames into "collectedFrames" (indexed by frame type) instead of sending them.
+	 */
+	PVariable collectValues(BaseLib::PRpcClientInfo clientInfo, int32_t channel, PVariable variables, bool checkAcls, std::map<int32_t, PVariable>& collectedFrames);
+
+	/**
+	 * Writes parameters queued by the persistence queue to the database.
+	 *
+	 * @param rows The database IDs and the data of the parameters.
+	 */
+	void saveParameters(std::vector<std::pair<uint64_t, std::vector<uint8_t>>>& rows);
+
+	/**
+	 * Sends the JSON of a frame to the bridge.
+	 */
+	PVariable sendFrame(BaseLib::PRpcClientInfo& clientInfo, int32_t type, PVariable json, bool wait);
 protected:
 	//In table variables:
 	std::string _teamSerialNumber;
@@ -150,8 +166,9 @@ protected:
 	std::shared_ptr<BaseLib::Rpc::RpcEncoder> _binaryEncoder;
 	std::shared_ptr<BaseLib::Rpc::RpcDecoder> _binaryDecoder;
 
+	std::shared_ptr<PacketBindings> _packetBindings; //Only accessed while "_incomingPacketMutex" is locked.
+
 	std::timed_mutex _incomingPacketMutex;
-	int64_t _ignorePacketsUntil = 0;
 	bool _state = false;
 	int32_t _setColorMode = 0;
 	PVariable _setEffect;
@@ -177,7 +194,18 @@ protected:
 	double getHueFactor(const double& hue);
 	double getHueFactor(const int32_t& hue);
 
-	PVariable setValue(BaseLib::PRpcClientInfo clientInfo, uint32_t channel, std::string valueKey, PVariable value, bool noSending, bool wait);
+	/**
+	 * Sets a value.
+	 *
+	 * @param noSending Only update the value without sending it to the bridge.
+	 * @param collectedFrames When set, the JSON of the frames is merged into this map (indexed by frame type) instead of being sent, so several values can be sent in one request.
+	 */
+	PVariable setValue(BaseLib::PRpcClientInfo clientInfo, uint32_t channel, std::string valueKey, PVariable value, bool noSending, bool wait, std::map<int32_t, PVariable>* collectedFrames = nullptr);
+
+	/**
+	 * Saves the data of a variable. Existing variables are written by the persistence queue according to their persistence policy when it is enabled.
+	 */
+	void saveParameterData(BaseLib::Systems::RpcConfigurationParameter& parameter, uint32_t channel, const std::string& name, std::vector<uint8_t>& data);
 
 	virtual void loadVariables(BaseLib::Systems::ICentral* central, std::shared_ptr<BaseLib::Database::DataTable>& rows);
     virtual void saveVariables();
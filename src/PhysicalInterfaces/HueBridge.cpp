@@ -29,6 +29,8 @@
 
 #include "HueBridge.h"
 #include "../GD.h"
+#include "../Crc32c.h"
+#include "../JsonMemberScanner.h"
 
 namespace PhilipsHue {
 HueBridge::HueBridge(std::shared_ptr<BaseLib::Systems::PhysicalInterfaceSettings> settings) : IPhilipsHueInterface(settings) {
@@ -56,6 +58,85 @@ HueBridge::HueBridge(std::shared_ptr<BaseLib::Systems::PhysicalInterfaceSettings
   if (setting) _pollingInterval = (uint32_t)setting->integerValue;
   if (_pollingInterval < 1000) _pollingInterval = 1000;
 
+  _pollEndpoints[0].category = PhilipsHuePacket::Category::light;
+  _pollEndpoints[0].path = "/lights";
+  _pollEndpoints[0].intervalSetting = "lightpollinginterval";
+  _pollEndpoints[0].interval = _pollingInterval;
+  _pollEndpoints[1].category = PhilipsHuePacket::Category::group;
+  _pollEndpoints[1].path = "/groups";
+  _pollEndpoints[1].intervalSetting = "grouppollinginterval";
+  _pollEndpoints[1].interval = _pollingInterval;
+  _pollEndpoints[2].category = PhilipsHuePacket::Category::sensor;
+  _pollEndpoints[2].path = "/sensors";
+  _pollEndpoints[2].intervalSetting = "sensorpollinginterval";
+  _pollEndpoints[2].interval = 250;
+  for (auto &endpoint : _pollEndpoints) {
+    setting = GD::family->getFamilySetting(endpoint.intervalSetting);
+    if (setting) endpoint.interval = (uint32_t)setting->integerValue;
+    if (endpoint.interval > 0 && endpoint.interval < 100) endpoint.interval = 100;
+  }
+
+  settingName = "minpollinginterval";
+  setting = GD::family->getFamilySetting(settingName);
+  if (setting) _minPollingInterval = (uint32_t)setting->integerValue;
+  if (_minPollingInterval < 100) _minPollingInterval = 100;
+
+  settingName = "maxpollinginterval";
+  setting = GD::family->getFamilySetting(settingName);
+  if (setting) _maxPollingInterval = (uint32_t)setting->integerValue;
+  if (_maxPollingInterval > 0 && _maxPollingInterval < _minPollingInterval) _maxPollingInterval = _minPollingInterval;
+
+  for (auto &endpoint : _pollEndpoints) {
+    //Button presses and presence changes can't be anticipated from any other activity, so sensors are always polled at their configured interval.
+    if (endpoint.category == PhilipsHuePacket::Category::sensor) {
+      endpoint.minInterval = endpoint.interval;
+      endpoint.maxInterval = endpoint.interval;
+    } else {
+      endpoint.minInterval = std::min(_minPollingInterval, endpoint.interval);
+      endpoint.maxInterval = _maxPollingInterval == 0 ? endpoint.interval : std::max(_maxPollingInterval, endpoint.interval);
+    }
+    endpoint.currentInterval = endpoint.interval;
+  }
+
+  settingName = "connectionpoolsize";
+  setting = GD::family->getFamilySetting(settingName);
+  if (setting && setting->integerValue > 0) _connectionPoolSize = (uint32_t)setting->integerValue;
+
+  settingName = "commandqueuesize";
+  setting = GD::family->getFamilySetting(settingName);
+  if (setting && setting->integerValue > 0) _commandQueueSize = (uint32_t)setting->integerValue;
+
+  settingName = "lightcommandrate";
+  setting = GD::family->getFamilySetting(settingName);
+  if (setting) _lightBucket.rate = setting->integerValue;
+  _lightBucket.capacity = std::max(1.0, _lightBucket.rate);
+  _lightBucket.tokens = _lightBucket.capacity;
+
+  settingName = "groupcommandrate";
+  setting = GD::family->getFamilySetting(settingName);
+  if (setting) _groupBucket.rate = setting->integerValue;
+  _groupBucket.capacity = std::max(1.0, _groupBucket.rate);
+  _groupBucket.tokens = _groupBucket.capacity;
+
+  settingName = "eventstream";
+  setting = GD::family->getFamilySetting(settingName);
+  if (setting) {
+    std::string value = setting->stringValue;
+    _eventStream = (setting->integerValue == 1 || BaseLib::HelperFunctions::toLower(value) == "true");
+  }
+
+  settingName = "reconciliationinterval";
+  setting = GD::family->getFamilySetting(settingName);
+  if (setting) _reconciliationInterval = (uint32_t)setting->integerValue;
+  if (_reconciliationInterval < _pollingInterval) _reconciliationInterval = _pollingInterval;
+
+  //The pool is never changed afterwards, so it can be used by all threads without locking. stopListening() only disconnects the clients.
+  for (uint32_t i = 0; i < _connectionPoolSize; i++) {
+    _connections.emplace_back(new PooledConnection());
+    _connections.back()->client = std::unique_ptr<BaseLib::HttpClient>(new BaseLib::HttpClient(_bl, _hostname, _port, false, _settings->ssl, _settings->caFile, _settings->verifyCertificate));
+  }
+  _connectionPoolStartTime = BaseLib::HelperFunctions::getTime();
+
   _jsonEncoder.reset(new BaseLib::Rpc::JsonEncoder(GD::bl));
   _jsonDecoder.reset(new BaseLib::Rpc::JsonDecoder(GD::bl));
 }
@@ -63,8 +144,10 @@ HueBridge::HueBridge(std::shared_ptr<BaseLib::Systems::PhysicalInterfaceSettings
 HueBridge::~HueBridge() {
   try {
     _stopCallbackThread = true;
-    _bl->threadManager.join(_listenThread);
-    _client.reset();
+    removeTask(_pollTask);
+    _bl->threadManager.join(_eventStreamThread);
+    stopSender();
+    _connections.clear();
   }
   catch (const std::exception &ex) {
     _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
@@ -77,13 +160,271 @@ bool HueBridge::userCreated() {
 }
 
 void HueBridge::sendPacket(std::shared_ptr<BaseLib::Systems::Packet> packet) {
+  queuePacket(std::dynamic_pointer_cast<PhilipsHuePacket>(packet), CommandPriority::interactive);
+}
+
+std::future<bool> HueBridge::queuePacket(std::shared_ptr<PhilipsHuePacket> packet, CommandPriority priority) {
+  std::promise<bool> promise;
+  std::future<bool> result = promise.get_future();
   try {
-    if (_noHost) return;
-    if (!packet) {
-      _out.printWarning("Warning: Packet was nullptr.");
-      return;
+    if (_noHost || !packet || !packet->getJson()) {
+      if (!packet) _out.printWarning("Warning: Packet was nullptr.");
+      promise.set_value(false);
+      return result;
+    }
+
+    {
+      std::lock_guard<std::mutex> commandQueueGuard(_commandQueueMutex);
+      auto &lane = _commandLanes[(int32_t)priority];
+      int64_t destination = getDestination(packet);
+      auto commandsIterator = lane.commands.find(destination);
+      if (commandsIterator != lane.commands.end() && mergeCommand(commandsIterator->second.back(), packet)) {
+        //The pending command now carries the new values, so the caller is notified when it was sent.
+        commandsIterator->second.back()->results.push_back(std::move(promise));
+        if (priority == CommandPriority::interactive) _interactiveCommands++;
+        else _bulkCommands++;
+        return result;
+      }
+
+      if (_queuedCommands >= _commandQueueSize) {
+        _rejectedCommands++;
+        _out.printError("Error: Command queue is full. Dropping command to " + BaseLib::HelperFunctions::getHexString(packet->destinationAddress()) + ".");
+        promise.set_value(false);
+        return result;
+      }
+
+      auto command = std::make_shared<QueuedCommand>();
+      command->packet = packet;
+      command->priority = priority;
+      command->enqueueTime = BaseLib::HelperFunctions::getTime();
+      command->results.push_back(std::move(promise));
+
+      auto &commands = lane.commands[destination];
+      if (commands.empty()) lane.destinations.push_back(destination);
+      commands.push_back(command);
+      _queuedCommands++;
+      if (_queuedCommands > _maxCommandQueueDepth) _maxCommandQueueDepth = _queuedCommands;
+      if (priority == CommandPriority::interactive) _interactiveCommands++;
+      else _bulkCommands++;
+    }
+    if (_senderTask != -1 && GD::scheduler) GD::scheduler->wake(_senderTask);
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return result;
+}
+
+int64_t HueBridge::getDestination(const std::shared_ptr<PhilipsHuePacket> &packet) {
+  return ((int64_t)packet->getCategory() << 32) | (uint32_t)packet->destinationAddress();
+}
+
+bool HueBridge::mergeCommand(std::shared_ptr<QueuedCommand> &pendingCommand, std::shared_ptr<PhilipsHuePacket> &packet) {
+  try {
+    auto &pendingPacket = pendingCommand->packet;
+    if (pendingPacket->getCategory() != packet->getCategory() || pendingPacket->getMessageType() != packet->getMessageType()) return false;
+    PVariable pendingJson = pendingPacket->getJson();
+    PVariable json = packet->getJson();
+    if (pendingJson->type != BaseLib::VariableType::tStruct || json->type != BaseLib::VariableType::tStruct) return false;
+
+    //Transition times and effects apply to the values of their own command, so both commands must have the same ones. Alerts and increments are one-shot, so two of them must not collapse into one.
+    auto isStateKey = [](const std::string &key) {
+      return key != "transitiontime" && key != "alert" && key != "effect" && (key.size() < 4 || key.compare(key.size() - 4, 4, "_inc") != 0);
+    };
+    for (auto &element : *json->structValue) {
+      if (isStateKey(element.first)) continue;
+      if (element.first != "transitiontime" && element.first != "effect") return false;
+      auto elementIterator = pendingJson->structValue->find(element.first);
+      if (elementIterator == pendingJson->structValue->end() || !elementIterator->second || !element.second || !(*elementIterator->second == *element.second)) return false;
+    }
+    for (auto &element : *pendingJson->structValue) {
+      if (!isStateKey(element.first) && json->structValue->find(element.first) == json->structValue->end()) return false;
+    }
+
+    //A light that is switched off doesn't accept any other value, so "on":false can't be combined with values of the other command.
+    auto isSwitchedOff = [](const PVariable &json) {
+      auto onIterator = json->structValue->find("on");
+      return onIterator != json->structValue->end() && onIterator->second && !onIterator->second->booleanValue;
+    };
+    auto hasOtherValues = [&isStateKey](const PVariable &json) {
+      for (auto &element : *json->structValue) {
+        if (element.first != "on" && isStateKey(element.first)) return true;
+      }
+      return false;
+    };
+    if ((isSwitchedOff(pendingJson) && hasOtherValues(json) && json->structValue->find("on") == json->structValue->end()) || (isSwitchedOff(json) && hasOtherValues(pendingJson))) return false;
+
+    //Don't modify the JSON of the queued packet, it might still be referenced elsewhere.
+    auto mergedJson = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+    *mergedJson->structValue = *pendingJson->structValue;
+    for (auto &element : *json->structValue) {
+      auto elementIterator = mergedJson->structValue->find(element.first);
+      if (elementIterator != mergedJson->structValue->end()) {
+        elementIterator->second = element.second;
+        _supersededValues++;
+      } else mergedJson->structValue->emplace(element.first, element.second);
+    }
+
+    pendingPacket = std::make_shared<PhilipsHuePacket>(pendingPacket->getCategory(), pendingPacket->senderAddress(), pendingPacket->destinationAddress(), pendingPacket->getMessageType(), mergedJson);
+    _mergedCommands++;
+    return true;
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return false;
+}
+
+bool HueBridge::TokenBucket::take(int64_t time) {
+  if (rate <= 0) return true;
+  tokens = std::min(capacity, tokens + (double)(time - lastRefill) * rate / 1000.0);
+  lastRefill = time;
+  if (tokens < 1.0) return false;
+  tokens -= 1.0;
+  return true;
+}
+
+int64_t HueBridge::TokenBucket::timeUntilAvailable() {
+  if (rate <= 0 || tokens >= 1.0) return 0;
+  return (int64_t)std::ceil((1.0 - tokens) * 1000.0 / rate);
+}
+
+std::shared_ptr<HueBridge::QueuedCommand> HueBridge::getNextCommand(int64_t &waitTime) {
+  int64_t time = BaseLib::HelperFunctions::getTime();
+  waitTime = 1000;
+  std::array<bool, 3> categoryBlocked{false, false, false}; //Categories throttled for a command with higher priority
+
+  //Interactive commands first. Within a lane the destinations take turns, so one busy light can't starve the others.
+  for (auto &lane : _commandLanes) {
+    for (auto destinationIterator = lane.destinations.begin(); destinationIterator != lane.destinations.end(); ++destinationIterator) {
+      auto &commands = lane.commands[*destinationIterator];
+      auto command = commands.front();
+      auto category = command->packet->getCategory();
+      if (categoryBlocked[(int32_t)category]) continue;
+
+      if (command->nextAttempt > time) {
+        waitTime = std::min(waitTime, command->nextAttempt - time);
+        continue;
+      }
+
+      //Give the bridge some time between two commands to the same destination.
+      auto lastCommandTimeIterator = _lastCommandTimes.find(*destinationIterator);
+      if (lastCommandTimeIterator != _lastCommandTimes.end() && time - lastCommandTimeIterator->second < _settings->responseDelay) {
+        waitTime = std::min(waitTime, _settings->responseDelay - (time - lastCommandTimeIterator->second));
+        continue;
+      }
+
+      auto &bucket = category == PhilipsHuePacket::Category::group ? _groupBucket : _lightBucket;
+      if (!bucket.take(time)) {
+        categoryBlocked[(int32_t)category] = true;
+        waitTime = std::min(waitTime, bucket.timeUntilAvailable());
+        if (!command->throttled) {
+          command->throttled = true;
+          _throttledCommands++;
+        }
+        continue;
+      }
+
+      commands.pop_front();
+      int64_t destination = *destinationIterator;
+      lane.destinations.erase(destinationIterator);
+      if (commands.empty()) lane.commands.erase(destination);
+      else lane.destinations.push_back(destination);
+      _queuedCommands--;
+      return command;
+    }
+  }
+
+  if (waitTime < 1) waitTime = 1;
+  return std::shared_ptr<QueuedCommand>();
+}
+
+int64_t HueBridge::sendNextCommand() {
+  try {
+    std::shared_ptr<QueuedCommand> command;
+
+    {
+      std::lock_guard<std::mutex> commandQueueGuard(_commandQueueMutex);
+      if (_stopCallbackThread || _queuedCommands == 0) return 0;
+      int64_t waitTime = 0;
+      command = getNextCommand(waitTime);
+      if (!command) return BaseLib::HelperFunctions::getTime() + waitTime;
+    }
+
+    bool success = false;
+    bool retry = false;
+    try {
+      if (command->attempts > 0) _commandRetries++;
+      command->attempts++;
+      success = sendCommand(command->packet, command->attempts >= 5, retry);
+    }
+    catch (const std::exception &ex) {
+      _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+
+    {
+      std::lock_guard<std::mutex> commandQueueGuard(_commandQueueMutex);
+      int64_t destination = getDestination(command->packet);
+      _lastCommandTimes[destination] = BaseLib::HelperFunctions::getTime();
+      if (retry && !_stopCallbackThread) {
+        //Put the command back in front of its destination's queue instead of sleeping, which would block a thread shared by all bridges.
+        command->nextAttempt = BaseLib::HelperFunctions::getTime() + 1000;
+        auto &lane = _commandLanes[(int32_t)command->priority];
+        auto &commands = lane.commands[destination];
+        if (commands.empty()) lane.destinations.push_back(destination);
+        commands.push_front(command);
+        _queuedCommands++;
+        return BaseLib::HelperFunctions::getTime();
+      }
+    }
+
+    int64_t latency = BaseLib::HelperFunctions::getTime() - command->enqueueTime;
+    _commandLatencySum += latency;
+    if (latency > _maxCommandLatency) _maxCommandLatency = latency;
+    if (success) _sentCommands++;
+    else _failedCommands++;
+    for (auto &result : command->results) {
+      result.set_value(success);
+    }
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  //Run again right away. Tasks of other bridges that are due get their turn first.
+  return BaseLib::HelperFunctions::getTime();
+}
+
+void HueBridge::stopSender() {
+  try {
+    {
+      std::lock_guard<std::mutex> commandQueueGuard(_commandQueueMutex);
+      _stopCallbackThread = true;
+    }
+    removeTask(_senderTask);
+
+    std::lock_guard<std::mutex> commandQueueGuard(_commandQueueMutex);
+    for (auto &lane : _commandLanes) {
+      for (auto &commands : lane.commands) {
+        for (auto &command : commands.second) {
+          _failedCommands++;
+          for (auto &result : command->results) {
+            result.set_value(false);
+          }
+        }
+      }
+      lane.commands.clear();
+      lane.destinations.clear();
     }
+    _queuedCommands = 0;
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
 
+bool HueBridge::sendCommand(std::shared_ptr<PhilipsHuePacket> &huePacket, bool lastAttempt, bool &retry) {
+  retry = false;
+  try {
     std::string username;
 
     {
@@ -93,17 +434,19 @@ void HueBridge::sendPacket(std::shared_ptr<BaseLib::Systems::Packet> packet) {
 
     if (username.empty()) {
       _out.printInfo("Info: Not sending packet, because username is empty.");
-      return;
+      return false;
     }
     _lastAction = BaseLib::HelperFunctions::getTime();
 
-    std::shared_ptr<PhilipsHuePacket> huePacket(std::dynamic_pointer_cast<PhilipsHuePacket>(packet));
-    if (!huePacket) return;
-
     PVariable json = huePacket->getJson();
-    if (!json) return;
+    if (!json) return false;
+
+    if (!_eventStreamConnected) _nextPoll = BaseLib::HelperFunctions::getTime() + _minPollingInterval; // No polling now
 
-    _nextPoll = BaseLib::HelperFunctions::getTime() + 2000; // No polling now
+    //Make sure, the next state of the destination is passed on even if the command didn't change anything on the bridge. Otherwise peers might keep the value that was just set.
+    if (huePacket->getCategory() == PhilipsHuePacket::Category::light) forgetFingerprint(PhilipsHuePacket::Category::light, (_settings->address << 20) | (huePacket->destinationAddress() & 0xFFFFF));
+    else forgetFingerprints();
+    _commandGeneration++;
 
     std::string data;
     _jsonEncoder->encode(json, data);
@@ -120,100 +463,75 @@ void HueBridge::sendPacket(std::shared_ptr<BaseLib::Systems::Packet> packet) {
     BaseLib::Http response;
 
     std::string exception;
-    for (int i = 0; i < 5; i++) {
-      try {
-        if (_stopCallbackThread || GD::bl->shuttingDown) return;
-        _client->sendRequest(data, response);
-        if (response.getHeader().responseCode < 200 || response.getHeader().responseCode > 299) {
-          exception = "Error sending command to Hue Bridge. Response code was: " + std::to_string(response.getHeader().responseCode);
-          std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-          continue;
-        } else exception = "";
-        break;
-      }
-      catch (const std::exception &ex) {
-        exception = std::string(ex.what());
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+    try {
+      if (_stopCallbackThread || GD::bl->shuttingDown) return false;
+      int64_t startTime = BaseLib::HelperFunctions::getTimeMicroseconds();
+      sendRequest(ConnectionPurpose::command, data, response);
+      _commandRoundTripTimes.record(BaseLib::HelperFunctions::getTimeMicroseconds() - startTime);
+      _bytesReceived += response.getContentSize();
+      if (response.getHeader().responseCode < 200 || response.getHeader().responseCode > 299) {
+        exception = "Error sending command to Hue Bridge. Response code was: " + std::to_string(response.getHeader().responseCode);
       }
     }
+    catch (const std::exception &ex) {
+      exception = std::string(ex.what());
+    }
 
     std::string responseString(response.getContent().data(), response.getContentSize());
     if (!exception.empty()) {
+      if (!lastAttempt) {
+        retry = true;
+        return false;
+      }
       _out.printError("Error: Command was not send to Hue Bridge: " + exception + " Response was: " + responseString);
     }
 
+    bool success = exception.empty();
     json = getJson(responseString);
-    if (!json) return;
+    if (!json) return false;
 
     if (!json->arrayValue->empty() && json->arrayValue->at(0)->structValue->find("error") != json->arrayValue->at(0)->structValue->end()) {
-      json = json->arrayValue->at(0)->structValue->at("error");
-      if (json->structValue->find("description") != json->structValue->end()) _out.printError("Error: " + json->structValue->at("description")->stringValue);
+      success = false;
+      PVariable error = json->arrayValue->at(0)->structValue->at("error");
+      if (error->structValue->find("description") != error->structValue->end()) _out.printError("Error: " + error->structValue->at("description")->stringValue);
       else _out.printError("Unknown error sending packet. Response was: " + responseString);
     }
 
-    _nextPoll = BaseLib::HelperFunctions::getTime() + 2000; // Poll in 2 seconds
-
-    /*std::string getData = "GET /api/homegear" + _settings->id + "/lights/" + std::to_string(packet->destinationAddress()) + " HTTP/1.1\r\nUser-Agent: Homegear\r\nHost: " + _hostname + ":" + std::to_string(_port) + "\r\nConnection: Keep-Alive\r\n\r\n";
-    for(int i = 0; i < 5; i++)
-    {
-        try
-        {
-            _client->sendRequest(getData, response);
-            exception = Exception("");
-            break;
-        }
-        catch(Exception& ex)
-        {
-            exception = ex;
-            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-        }
-    }
-    if(!exception.what().empty())
-    {
-        _out.printWarning("Warning: Could not read updated data from Hue Bridge: " + exception.what());
-    }
-
-    json = getJson(response);
-    if(!json) return;
-    if(!json->arrayValue->empty() && json->arrayValue->at(0)->structValue->find("error") != json->arrayValue->at(0)->structValue->end())
-    {
-        json = json->arrayValue->at(0)->structValue->at("error");
-        if(json->structValue->find("type") != json->structValue->end() && json->structValue->at("type")->integerValue == 1)
-        {
-            createUser();
-        }
-        else
-        {
-            if(json->structValue->find("description") != json->structValue->end()) _out.printError("Error: " + json->structValue->at("description")->stringValue);
-            else _out.printError("Unknown error during polling. Response was: " + response);
-        }
-        return;
+    //The response contains the applied values, so the new state doesn't need to be polled. Group commands also change the member lights, so they still need a poll.
+    bool applied = applyCommandResponse(huePacket, json);
+    if (!_eventStreamConnected && (!applied || huePacket->getCategory() == PhilipsHuePacket::Category::group)) {
+      // Poll soon and keep polling fast for a while. Not necessary when the event stream is connected.
+      _nextPoll = BaseLib::HelperFunctions::getTime() + _minPollingInterval;
+      _forcePoll = true;
+      wakePollTask();
     }
 
-    if(json->structValue->find("state") != json->structValue->end())
-    {
-        std::shared_ptr<PhilipsHuePacket> packet(new PhilipsHuePacket(huePacket->destinationAddress(), 0, 1, json, BaseLib::HelperFunctions::getTime()));
-        raisePacketReceived(packet);
-    }*/
-
     _lastPacketSent = BaseLib::HelperFunctions::getTime();
+    return success;
   }
   catch (const std::exception &ex) {
     _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
   }
+  return false;
 }
 
 void HueBridge::startListening() {
   try {
     stopListening();
-    _client = std::unique_ptr<BaseLib::HttpClient>(new BaseLib::HttpClient(_bl, _hostname, _port, false, _settings->ssl, _settings->caFile, _settings->verifyCertificate));
-    _ipAddress = _client->getIpAddress();
+    if (!_connections.empty()) _ipAddress = _connections.front()->client->getIpAddress();
     _myAddress = _settings->address;
     _noHost = _hostname.empty();
     _connected = false;
-    if (!_noHost) {
-      if (_settings->listenThreadPriority > -1) _bl->threadManager.start(_listenThread, true, _settings->listenThreadPriority, _settings->listenThreadPolicy, &HueBridge::listen, this);
-      else _bl->threadManager.start(_listenThread, true, &HueBridge::listen, this);
+    if (!_noHost && GD::scheduler) {
+      {
+        std::lock_guard<std::mutex> usernameGuard(_usernameMutex);
+        _pollUsername = _username;
+      }
+      if (!_pollUsername.empty()) _bl->globalServiceMessages.unset(HUE_FAMILY_ID, 0, _settings->id, "l10n.philipshue.bridge.pressLinkButton");
+
+      _pollTask = GD::scheduler->add(std::bind(&HueBridge::pollDueEndpoints, this), BaseLib::HelperFunctions::getTime());
+      _senderTask = GD::scheduler->add(std::bind(&HueBridge::sendNextCommand, this), 0);
+      if (_eventStream) _bl->threadManager.start(_eventStreamThread, true, &HueBridge::eventStream, this);
     }
     IPhysicalInterface::startListening();
   }
@@ -225,9 +543,14 @@ void HueBridge::startListening() {
 void HueBridge::stopListening() {
   try {
     _stopCallbackThread = true;
-    _bl->threadManager.join(_listenThread);
+    removeTask(_pollTask);
+    _bl->threadManager.join(_eventStreamThread);
+    stopSender();
     _stopCallbackThread = false;
-    if (_client) _client->disconnect();
+    for (auto &connection : _connections) {
+      std::lock_guard<std::mutex> connectionGuard(connection->mutex);
+      connection->client->disconnect();
+    }
     IPhysicalInterface::stopListening();
   }
   catch (const std::exception &ex) {
@@ -235,6 +558,65 @@ void HueBridge::stopListening() {
   }
 }
 
+template<typename Response>
+void HueBridge::sendRequest(ConnectionPurpose purpose, const std::string &request, Response &response) {
+  if (_connections.empty()) throw BaseLib::Exception("No connection to Hue Bridge.");
+
+  //With less connections than purposes, the remaining purposes share the last connection. Other requests are spread over all additional connections.
+  size_t first = std::min((size_t)purpose, _connections.size() - 1);
+  size_t last = purpose == ConnectionPurpose::other ? _connections.size() - 1 : first;
+  size_t index = first;
+  PooledConnection *connection = nullptr;
+  std::unique_lock<std::mutex> connectionGuard;
+  for (size_t i = first; i <= last; i++) {
+    std::unique_lock<std::mutex> guard(_connections.at(i)->mutex, std::try_to_lock);
+    if (guard.owns_lock()) {
+      index = i;
+      connection = _connections.at(i).get();
+      connectionGuard = std::move(guard);
+      break;
+    }
+  }
+  if (!connection) {
+    index = first + (_nextConnection++ % (last - first + 1));
+    connection = _connections.at(index).get();
+    connection->waits++;
+    connectionGuard = std::unique_lock<std::mutex>(connection->mutex);
+  }
+
+  int64_t startTime = BaseLib::HelperFunctions::getTime();
+  int64_t startTimeMicroseconds = BaseLib::HelperFunctions::getTimeMicroseconds();
+  bool reconnect = !connection->client->connected();
+  uint64_t previousRequests = connection->requests++;
+  try {
+    connection->client->sendRequest(request, response);
+    connection->consecutiveFailures = 0;
+    connection->busyTime += BaseLib::HelperFunctions::getTime() - startTime;
+    if (reconnect) {
+      _reconnectTimes.record(BaseLib::HelperFunctions::getTimeMicroseconds() - startTimeMicroseconds);
+      if (previousRequests > 0) connection->reconnects++;
+    }
+  }
+  catch (const std::exception &ex) {
+    connection->busyTime += BaseLib::HelperFunctions::getTime() - startTime;
+    connection->failures++;
+    //The bridge silently drops idle keep-alive connections. Don't try to reuse a connection that failed.
+    connection->client->disconnect();
+    if (++connection->consecutiveFailures == 3) _out.printWarning("Warning: Connection " + std::to_string(index) + " to Hue Bridge failed 3 times in a row: " + std::string(ex.what()));
+    throw;
+  }
+}
+
+void HueBridge::removeTask(std::atomic<int32_t> &task) {
+  int32_t id = task.exchange(-1);
+  if (id != -1 && GD::scheduler) GD::scheduler->remove(id);
+}
+
+void HueBridge::wakePollTask() {
+  int32_t id = _pollTask;
+  if (id != -1 && GD::scheduler) GD::scheduler->wake(id);
+}
+
 void HueBridge::createUser() {
   try {
     if (_noHost) return;
@@ -250,7 +632,7 @@ void HueBridge::createUser() {
     data.insert(data.begin(), header.begin(), header.end());
     std::string response;
 
-    _client->sendRequest(data, response);
+    sendRequest(ConnectionPurpose::other, data, response);
     //_out.printInfo(response);
 
     PVariable json = getJson(response);
@@ -312,7 +694,7 @@ void HueBridge::searchLights() {
     std::string header = "POST /api/" + username + "/lights HTTP/1.1\r\nUser-Agent: Homegear\r\nHost: " + _hostname + ":" + std::to_string(_port) + "\r\nContent-Type: application/json\r\nContent-Length: 0\r\nConnection: Keep-Alive\r\n\r\n";
     std::string response;
 
-    _client->sendRequest(header, response);
+    sendRequest(ConnectionPurpose::other, header, response);
 
     PVariable json = getJson(response);
     if (!json) return;
@@ -327,7 +709,7 @@ void HueBridge::searchLights() {
 
     header = "GET /api/" + username + "/lights/new HTTP/1.1\r\nUser-Agent: Homegear\r\nHost: " + _hostname + ":" + std::to_string(_port) + "\r\nConnection: Keep-Alive\r\n\r\n";
 
-    _client->sendRequest(header, response);
+    sendRequest(ConnectionPurpose::other, header, response);
 
     json = getJson(response);
     if (!json) return;
@@ -357,9 +739,9 @@ std::set<std::shared_ptr<PhilipsHuePacket>> HueBridge::getPeerInfo() {
 
     std::string getAllData = "GET /api/" + username + " HTTP/1.1\r\nUser-Agent: Homegear\r\nHost: " + _hostname + ":" + std::to_string(_port) + "\r\nConnection: Keep-Alive\r\n\r\n";
     std::string response;
-    _client->sendRequest(getAllData, response);
+    sendRequest(ConnectionPurpose::other, getAllData, response);
 
-    PVariable json = getJson(response);
+    PVariable json = getJson(response, {"lights", "sensors"});
     if (!json) return std::set<std::shared_ptr<PhilipsHuePacket>>();
 
     if (!json->arrayValue->empty() && json->arrayValue->at(0)->structValue->find("error") != json->arrayValue->at(0)->structValue->end()) {
@@ -371,19 +753,19 @@ std::set<std::shared_ptr<PhilipsHuePacket>> HueBridge::getPeerInfo() {
 
     std::set<std::shared_ptr<PhilipsHuePacket>> peers;
     if (json->structValue->find("lights") != json->structValue->end()) {
-      json = json->structValue->at("lights");
-      for (auto i = json->structValue->begin(); i != json->structValue->end(); ++i) {
+      PVariable lights = json->structValue->at("lights");
+      for (auto i = lights->structValue->begin(); i != lights->structValue->end(); ++i) {
         std::string address = i->first;
-        std::shared_ptr<PhilipsHuePacket> packet(new PhilipsHuePacket(PhilipsHuePacket::Category::light, (_settings->address << 20) | BaseLib::Math::getNumber(address), 0, 1, i->second, BaseLib::HelperFunctions::getTime()));
+        std::shared_ptr<PhilipsHuePacket> packet(new PhilipsHuePacket(PhilipsHuePacket::Category::light, getResourceAddress(PhilipsHuePacket::Category::light, BaseLib::Math::getNumber(address)), 0, 1, i->second, BaseLib::HelperFunctions::getTime()));
         peers.emplace(packet);
       }
     }
 
     if (json->structValue->find("sensors") != json->structValue->end()) {
-      json = json->structValue->at("sensors");
-      for (auto i = json->structValue->begin(); i != json->structValue->end(); ++i) {
+      PVariable sensors = json->structValue->at("sensors");
+      for (auto i = sensors->structValue->begin(); i != sensors->structValue->end(); ++i) {
         std::string address = i->first;
-        std::shared_ptr<PhilipsHuePacket> packet(new PhilipsHuePacket(PhilipsHuePacket::Category::sensor, (_settings->address << 20) | BaseLib::Math::getNumber(address), 0, 1, i->second, BaseLib::HelperFunctions::getTime()));
+        std::shared_ptr<PhilipsHuePacket> packet(new PhilipsHuePacket(PhilipsHuePacket::Category::sensor, getResourceAddress(PhilipsHuePacket::Category::sensor, BaseLib::Math::getNumber(address)), 0, 1, i->second, BaseLib::HelperFunctions::getTime()));
         peers.emplace(packet);
       }
     }
@@ -409,9 +791,9 @@ std::set<std::shared_ptr<PhilipsHuePacket>> HueBridge::getGroupInfo() {
 
     std::string getAllData = "GET /api/" + username + " HTTP/1.1\r\nUser-Agent: Homegear\r\nHost: " + _hostname + ":" + std::to_string(_port) + "\r\nConnection: Keep-Alive\r\n\r\n";
     std::string response;
-    _client->sendRequest(getAllData, response);
+    sendRequest(ConnectionPurpose::other, getAllData, response);
 
-    PVariable json = getJson(response);
+    PVariable json = getJson(response, {"groups"});
     if (!json) return std::set<std::shared_ptr<PhilipsHuePacket>>();
 
     if (!json->arrayValue->empty() && json->arrayValue->at(0)->structValue->find("error") != json->arrayValue->at(0)->structValue->end()) {
@@ -451,114 +833,579 @@ PVariable HueBridge::getJson(std::string &jsonString) {
   return PVariable();
 }
 
-void HueBridge::listen() {
+PVariable HueBridge::getJson(std::string &jsonString, const std::vector<std::string> &members) {
   try {
-    std::string username;
+    PVariable json = JsonMemberScanner::decodeMembers(*_jsonDecoder, jsonString, members);
+    if (json) return json;
+  }
+  catch (const BaseLib::Rpc::JsonDecoderException &ex) {
+    _out.printError("Error parsing json: " + std::string(ex.what()) + ". Data was: " + jsonString);
+    return PVariable();
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return getJson(jsonString);
+}
 
-    {
-      std::lock_guard<std::mutex> usernameGuard(_usernameMutex);
-      username = _username;
+bool HueBridge::resourceChanged(PhilipsHuePacket::Category category, int32_t address, const PVariable &json) {
+  try {
+    std::string encodedJson;
+    _jsonEncoder->encode(json, encodedJson);
+    size_t fingerprint = std::hash<std::string>()(encodedJson);
+
+    std::lock_guard<std::mutex> fingerprintsGuard(_fingerprintsMutex);
+    auto &fingerprints = _fingerprints[(int32_t)category];
+    auto fingerprintIterator = fingerprints.find(address);
+    if (fingerprintIterator != fingerprints.end() && fingerprintIterator->second == fingerprint) {
+      _skippedResources++;
+      return false;
     }
+    fingerprints[address] = fingerprint;
+    _dispatchedResources++;
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return true;
+}
 
-    std::string getAllData = "GET /api/" + username + " HTTP/1.1\r\nUser-Agent: Homegear\r\nHost: " + _hostname + ":" + std::to_string(_port) + "\r\nConnection: Keep-Alive\r\n\r\n";
-    std::string response;
-    std::string exception;
+void HueBridge::forgetFingerprint(PhilipsHuePacket::Category category, int32_t address) {
+  std::lock_guard<std::mutex> fingerprintsGuard(_fingerprintsMutex);
+  _fingerprints[(int32_t)category].erase(address);
+}
 
-    if (!username.empty()) _bl->globalServiceMessages.unset(HUE_FAMILY_ID, 0, _settings->id, "l10n.philipshue.bridge.pressLinkButton");
+void HueBridge::forgetFingerprints() {
+  std::lock_guard<std::mutex> fingerprintsGuard(_fingerprintsMutex);
+  for (auto &fingerprints : _fingerprints) {
+    fingerprints.clear();
+  }
+}
 
-    while (!_stopCallbackThread) {
-      try {
-        while (BaseLib::HelperFunctions::getTime() < _nextPoll) {
-          std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-          if (_stopCallbackThread) return;
-        }
-        _nextPoll = BaseLib::HelperFunctions::getTime() + _pollingInterval;
-        if (username.empty()) {
-          {
-            std::lock_guard<std::mutex> usernameGuard(_usernameMutex);
-            username = _username;
-          }
+PVariable HueBridge::getStatistics() {
+  auto statistics = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+  try {
+    uint64_t dispatchedResources = _dispatchedResources;
+    uint64_t skippedResources = _skippedResources;
+    statistics->structValue->emplace("dispatchedResources", std::make_shared<BaseLib::Variable>((int64_t)dispatchedResources));
+    statistics->structValue->emplace("skippedResources", std::make_shared<BaseLib::Variable>((int64_t)skippedResources));
+    statistics->structValue->emplace("skipRatio", std::make_shared<BaseLib::Variable>(dispatchedResources + skippedResources == 0 ? 0.0 : (double)skippedResources / (double)(dispatchedResources + skippedResources)));
+    statistics->structValue->emplace("polls", std::make_shared<BaseLib::Variable>((int64_t)_polls));
+    statistics->structValue->emplace("shortCircuitedPolls", std::make_shared<BaseLib::Variable>((int64_t)_shortCircuitedPolls));
+    statistics->structValue->emplace("pollLatency", std::make_shared<BaseLib::Variable>((int64_t)_pollLatency));
+    for (auto &endpoint : _pollEndpoints) {
+      statistics->structValue->emplace(endpoint.path.substr(1) + "PollingInterval", std::make_shared<BaseLib::Variable>((int64_t)endpoint.currentInterval));
+    }
+
+    size_t commandQueueDepth = 0;
+    {
+      std::lock_guard<std::mutex> commandQueueGuard(_commandQueueMutex);
+      commandQueueDepth = _queuedCommands;
+    }
+    uint64_t sentCommands = _sentCommands;
+    uint64_t failedCommands = _failedCommands;
+    statistics->structValue->emplace("commandQueueDepth", std::make_shared<BaseLib::Variable>((int64_t)commandQueueDepth));
+    statistics->structValue->emplace("maxCommandQueueDepth", std::make_shared<BaseLib::Variable>((int64_t)_maxCommandQueueDepth));
+    statistics->structValue->emplace("sentCommands", std::make_shared<BaseLib::Variable>((int64_t)sentCommands));
+    statistics->structValue->emplace("failedCommands", std::make_shared<BaseLib::Variable>((int64_t)failedCommands));
+    statistics->structValue->emplace("rejectedCommands", std::make_shared<BaseLib::Variable>((int64_t)_rejectedCommands));
+    statistics->structValue->emplace("averageCommandLatency", std::make_shared<BaseLib::Variable>(sentCommands + failedCommands == 0 ? (int64_t)0 : _commandLatencySum / (int64_t)(sentCommands + failedCommands)));
+    statistics->structValue->emplace("maxCommandLatency", std::make_shared<BaseLib::Variable>((int64_t)_maxCommandLatency));
+    statistics->structValue->emplace("interactiveCommands", std::make_shared<BaseLib::Variable>((int64_t)_interactiveCommands));
+    statistics->structValue->emplace("bulkCommands", std::make_shared<BaseLib::Variable>((int64_t)_bulkCommands));
+    statistics->structValue->emplace("throttledCommands", std::make_shared<BaseLib::Variable>((int64_t)_throttledCommands));
+    statistics->structValue->emplace("mergedCommands", std::make_shared<BaseLib::Variable>((int64_t)_mergedCommands));
+    statistics->structValue->emplace("supersededValues", std::make_shared<BaseLib::Variable>((int64_t)_supersededValues));
+    statistics->structValue->emplace("appliedCommandResponses", std::make_shared<BaseLib::Variable>((int64_t)_appliedCommandResponses));
+
+    auto connections = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tArray);
+    int64_t poolAge = std::max((int64_t)1, BaseLib::HelperFunctions::getTime() - _connectionPoolStartTime);
+    for (auto &connection : _connections) {
+      auto connectionStatistics = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+      connectionStatistics->structValue->emplace("requests", std::make_shared<BaseLib::Variable>((int64_t)connection->requests));
+      connectionStatistics->structValue->emplace("failures", std::make_shared<BaseLib::Variable>((int64_t)connection->failures));
+      connectionStatistics->structValue->emplace("reconnects", std::make_shared<BaseLib::Variable>((int64_t)connection->reconnects));
+      connectionStatistics->structValue->emplace("waits", std::make_shared<BaseLib::Variable>((int64_t)connection->waits));
+      connectionStatistics->structValue->emplace("utilization", std::make_shared<BaseLib::Variable>((double)connection->busyTime / (double)poolAge));
+      connections->arrayValue->push_back(connectionStatistics);
+    }
+    statistics->structValue->emplace("connections", connections);
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return statistics;
+}
 
-          if (username.empty()) {
-            createUser();
+PVariable HueBridge::getMetrics() {
+  auto metrics = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+  try {
+    metrics->structValue->emplace("pollRoundTripTime", _pollRoundTripTimes.toVariable());
+    metrics->structValue->emplace("commandRoundTripTime", _commandRoundTripTimes.toVariable());
+    metrics->structValue->emplace("decodeTime", _decodeTimes.toVariable());
+    metrics->structValue->emplace("dispatchTime", _dispatchTimes.toVariable());
+    metrics->structValue->emplace("reconnectTime", _reconnectTimes.toVariable());
+    metrics->structValue->emplace("pollRetries", std::make_shared<BaseLib::Variable>((int64_t)_pollRetries));
+    metrics->structValue->emplace("pollErrors", std::make_shared<BaseLib::Variable>((int64_t)_pollErrors));
+    metrics->structValue->emplace("commandRetries", std::make_shared<BaseLib::Variable>((int64_t)_commandRetries));
+    metrics->structValue->emplace("commandErrors", std::make_shared<BaseLib::Variable>((int64_t)_failedCommands));
+    metrics->structValue->emplace("bytesReceived", std::make_shared<BaseLib::Variable>((int64_t)_bytesReceived));
+    metrics->structValue->emplace("packetsRaised", std::make_shared<BaseLib::Variable>((int64_t)_packetsRaised));
+    metrics->structValue->emplace("lastPacketSent", std::make_shared<BaseLib::Variable>((int64_t)_lastPacketSent));
+    metrics->structValue->emplace("lastPacketReceived", std::make_shared<BaseLib::Variable>((int64_t)_lastPacketReceived));
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return metrics;
+}
 
-            {
-              std::lock_guard<std::mutex> usernameGuard(_usernameMutex);
-              username = _username;
-            }
+int64_t HueBridge::pollDueEndpoints() {
+  try {
+    if (_stopCallbackThread) return 0;
+    int64_t time = BaseLib::HelperFunctions::getTime();
+    if (time < _nextPoll) return _nextPoll;
+
+    if (_pollUsername.empty()) {
+      {
+        std::lock_guard<std::mutex> usernameGuard(_usernameMutex);
+        _pollUsername = _username;
+      }
 
-            getAllData = "GET /api/" + username + " HTTP/1.1\r\nUser-Agent: Homegear\r\nHost: " + _hostname + ":" + std::to_string(_port) + "\r\nConnection: Keep-Alive\r\n\r\n";
+      if (_pollUsername.empty()) {
+        createUser();
 
-            _nextPoll = BaseLib::HelperFunctions::getTime() + 1000;
-            continue;
-          }
-        }
-        for (int32_t i = 0; i < 5; i++) {
-          try {
-            if (_stopCallbackThread) return;
-            _client->sendRequest(getAllData, response);
-            exception = "";
-            break;
-          }
-          catch (const std::exception &ex) {
-            exception = std::string(ex.what());
-            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-          }
+        {
+          std::lock_guard<std::mutex> usernameGuard(_usernameMutex);
+          _pollUsername = _username;
         }
-        if (!exception.empty()) {
-          _connected = false;
-          _out.printError("Error: Command was not send to Hue Bridge: " + exception);
+
+        _nextPoll = BaseLib::HelperFunctions::getTime() + 1000;
+        return _nextPoll;
+      }
+    }
+
+    if (_eventStreamConnected) {
+      //Only the full state is requested from time to time to catch anything the event stream might have missed.
+      if (_reconcileNow || time >= _reconciliationEndpoint.nextPoll) {
+        _reconcileNow = false;
+        _reconciliationEndpoint.nextPoll = time + _reconciliationInterval;
+        if (!poll(_reconciliationEndpoint, _pollUsername)) return 0;
+        if (_reconciliationEndpoint.failedAttempts > 0) _reconciliationEndpoint.nextPoll = BaseLib::HelperFunctions::getTime() + 1000;
+      }
+      return std::max(_reconciliationEndpoint.nextPoll, (int64_t)_nextPoll);
+    }
+
+    bool forcePoll = _forcePoll.exchange(false);
+    int64_t nextPoll = 0;
+    for (auto &endpoint : _pollEndpoints) {
+      if (endpoint.interval == 0) continue;
+      if (forcePoll || time >= endpoint.nextPoll) {
+        endpoint.nextPoll = time + endpoint.currentInterval;
+        endpoint.changed = false;
+        if (!poll(endpoint, _pollUsername)) return 0;
+        if (_stopCallbackThread) return 0;
+        if (_pollUsername.empty()) return _nextPoll;
+        if (endpoint.failedAttempts > 0) {
+          //Retry the failed request without changing the interval.
+          endpoint.nextPoll = BaseLib::HelperFunctions::getTime() + 1000;
+          if (nextPoll == 0 || endpoint.nextPoll < nextPoll) nextPoll = endpoint.nextPoll;
           continue;
         }
 
-        _connected = true;
+        //Poll fast after commands and changes and back off exponentially while nothing changes. The time between two polls is at least four times the response time, so a slow bridge isn't kept busy with polling.
+        if (forcePoll || endpoint.changed) endpoint.currentInterval = endpoint.minInterval;
+        else endpoint.currentInterval = std::min(endpoint.currentInterval * 2, endpoint.maxInterval);
+        endpoint.nextPoll = BaseLib::HelperFunctions::getTime() + std::max((int64_t)endpoint.currentInterval, _pollLatency * 4);
+      }
+      if (nextPoll == 0 || endpoint.nextPoll < nextPoll) nextPoll = endpoint.nextPoll;
+    }
+    if (nextPoll == 0) return 0;
+    return std::max(nextPoll, (int64_t)_nextPoll);
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return BaseLib::HelperFunctions::getTime() + 1000;
+}
+
+bool HueBridge::poll(PollEndpoint &endpoint, std::string &username) {
+  std::string getData = "GET /api/" + username + endpoint.path + " HTTP/1.1\r\nUser-Agent: Homegear\r\nHost: " + _hostname + ":" + std::to_string(_port) + "\r\nConnection: Keep-Alive\r\n\r\n";
+  std::string response;
+  std::string exception;
+
+  int64_t commandGeneration = _commandGeneration;
+  try {
+    if (_stopCallbackThread) return true;
+    if (endpoint.failedAttempts > 0) _pollRetries++;
+    int64_t startTime = BaseLib::HelperFunctions::getTimeMicroseconds();
+    sendRequest(ConnectionPurpose::poll, getData, response);
+    int64_t roundTripTime = BaseLib::HelperFunctions::getTimeMicroseconds() - startTime;
+    _pollRoundTripTimes.record(roundTripTime);
+    _pollLatency = (_pollLatency * 7 + roundTripTime / 1000) / 8;
+  }
+  catch (const std::exception &ex) {
+    exception = std::string(ex.what());
+  }
+  if (!exception.empty()) {
+    //The poll task retries the endpoint after one second. Sleeping here would block a thread shared by all bridges.
+    if (++endpoint.failedAttempts < 5) return true;
+    endpoint.failedAttempts = 0;
+    _connected = false;
+    _pollErrors++;
+    _out.printError("Error: Command was not send to Hue Bridge: " + exception);
+    return true;
+  }
+
+  endpoint.failedAttempts = 0;
+  _connected = true;
+  _polls++;
+  _bytesReceived += response.size();
+
+  //An idle bridge returns exactly the same document on every poll. Don't decode it again in this case.
+  uint32_t digest = Crc32c::calculate(response);
+  if (endpoint.digestGeneration == commandGeneration && digest == endpoint.digest) {
+    _shortCircuitedPolls++;
+    _lastPacketReceived = BaseLib::HelperFunctions::getTime();
+    return true;
+  }
+
+  int64_t decodeStartTime = BaseLib::HelperFunctions::getTimeMicroseconds();
+  PVariable json = endpoint.path.empty() ? getJson(response, _pollMembers) : getJson(response);
+  _decodeTimes.record(BaseLib::HelperFunctions::getTimeMicroseconds() - decodeStartTime);
+  if (!json) {
+    _pollErrors++;
+    return false;
+  }
+
+  if (!json->arrayValue->empty() && json->arrayValue->at(0)->structValue->find("error") != json->arrayValue->at(0)->structValue->end()) {
+    json = json->arrayValue->at(0)->structValue->at("error");
+    if (json->structValue->find("type") != json->structValue->end() && json->structValue->at("type")->integerValue == 1) {
+      {
+        std::lock_guard<std::mutex> usernameGuard(_usernameMutex);
+        _username = "";
+      }
+      username.clear();
+      _nextPoll = BaseLib::HelperFunctions::getTime() + 25000;
+    } else {
+      if (json->structValue->find("description") != json->structValue->end()) _out.printError("Error: " + json->structValue->at("description")->stringValue);
+      else _out.printError("Unknown error during polling. Response was: " + response);
+    }
+    return true;
+  }
+
+  int64_t dispatchStartTime = BaseLib::HelperFunctions::getTimeMicroseconds();
+  size_t dispatchedResources = 0;
+  if (endpoint.path.empty()) {
+    auto lightsIterator = json->structValue->find("lights");
+    if (lightsIterator != json->structValue->end()) dispatchedResources += dispatchResources(PhilipsHuePacket::Category::light, lightsIterator->second);
+    auto groupsIterator = json->structValue->find("groups");
+    if (groupsIterator != json->structValue->end()) dispatchedResources += dispatchResources(PhilipsHuePacket::Category::group, groupsIterator->second);
+  } else dispatchedResources = dispatchResources(endpoint.category, json);
+  if (dispatchedResources > 0) {
+    endpoint.changed = true;
+    raiseBatchEnd();
+  }
+  _dispatchTimes.record(BaseLib::HelperFunctions::getTimeMicroseconds() - dispatchStartTime);
+
+  endpoint.digest = digest;
+  endpoint.digestGeneration = commandGeneration;
+  _lastPacketReceived = BaseLib::HelperFunctions::getTime();
+  return true;
+}
+
+bool HueBridge::applyCommandResponse(std::shared_ptr<PhilipsHuePacket> &packet, const PVariable &response) {
+  try {
+    if (response->type != BaseLib::VariableType::tArray) return false;
+
+    bool isGroup = packet->getCategory() == PhilipsHuePacket::Category::group;
+    int32_t id = packet->destinationAddress() & 0xFFFFF;
+    std::string prefix = (isGroup ? "/groups/" : "/lights/") + std::to_string(id) + (isGroup ? "/action/" : "/state/");
+    auto values = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+    for (auto &entry : *response->arrayValue) {
+      if (entry->type != BaseLib::VariableType::tStruct) continue;
+      auto successIterator = entry->structValue->find("success");
+      if (successIterator == entry->structValue->end() || successIterator->second->type != BaseLib::VariableType::tStruct) continue;
+      for (auto &value : *successIterator->second->structValue) {
+        if (value.first.compare(0, prefix.size(), prefix) != 0) continue;
+        std::string key = value.first.substr(prefix.size());
+        if (key.empty() || key.find('/') != std::string::npos) continue;
+        values->structValue->emplace(key, value.second);
+      }
+    }
+    if (values->structValue->empty()) return false;
+
+    //Looks like the corresponding part of a polled light or group, so the peers process it like any other state update.
+    auto json = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+    json->structValue->emplace(isGroup ? "action" : "state", values);
+    auto statePacket = std::make_shared<PhilipsHuePacket>(packet->getCategory(), getResourceAddress(packet->getCategory(), id), 0, isGroup ? 0x80 : 1, json, BaseLib::HelperFunctions::getTime());
+    raisePacketReceived(statePacket);
+    raiseBatchEnd();
+    _packetsRaised++;
+    _appliedCommandResponses++;
+    return true;
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return false;
+}
+
+size_t HueBridge::dispatchResources(PhilipsHuePacket::Category category, const PVariable &resources) {
+  size_t dispatchedResources = 0;
+  try {
+    for (auto &resource : *resources->structValue) {
+      std::string id = resource.first;
+      if (dispatchResource(category, BaseLib::Math::getNumber(id), resource.second)) dispatchedResources++;
+    }
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return dispatchedResources;
+}
+
+bool HueBridge::dispatchResource(PhilipsHuePacket::Category category, int32_t id, const PVariable &json) {
+  try {
+    int32_t address = getResourceAddress(category, id);
+    if (category == PhilipsHuePacket::Category::sensor) {
+      if (!sensorEventOccurred(address, json)) return false;
+    } else if (!resourceChanged(category, address, json)) return false;
+    auto packet = std::make_shared<PhilipsHuePacket>(category, address, 0, category == PhilipsHuePacket::Category::group ? 0x80 : 1, json, BaseLib::HelperFunctions::getTime());
+    raisePacketReceived(packet);
+    _packetsRaised++;
+    return true;
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return false;
+}
+
+int32_t HueBridge::getResourceAddress(PhilipsHuePacket::Category category, int32_t id) {
+  //Lights and sensors have separate ID ranges on the bridge, so sensors get an offset to be distinguishable.
+  if (category == PhilipsHuePacket::Category::sensor) id |= HUE_SENSOR_ADDRESS_OFFSET;
+  return (_settings->address << 20) | id;
+}
+
+bool HueBridge::sensorEventOccurred(int32_t address, const PVariable &json) {
+  try {
+    auto stateIterator = json->structValue->find("state");
+    if (stateIterator == json->structValue->end() || stateIterator->second->structValue->find("lastupdated") == stateIterator->second->structValue->end()) {
+      return resourceChanged(PhilipsHuePacket::Category::sensor, address, json);
+    }
+
+    //"lastupdated" only has a resolution of one second. Comparing the whole state also catches several events within the same second (e. g. "initial_press" and "short_release" of a button).
+    std::string state;
+    _jsonEncoder->encode(stateIterator->second, state);
+
+    std::lock_guard<std::mutex> sensorStatesGuard(_sensorStatesMutex);
+    auto sensorStateIterator = _sensorStates.find(address);
+    if (sensorStateIterator == _sensorStates.end()) {
+      //Don't repeat the last event (e. g. a button press) on startup.
+      _sensorStates.emplace(address, std::move(state));
+      _skippedResources++;
+      return false;
+    }
+    if (sensorStateIterator->second == state) {
+      _skippedResources++;
+      return false;
+    }
+    sensorStateIterator->second = std::move(state);
+    _dispatchedResources++;
+    return true;
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return false;
+}
+
+void HueBridge::eventStream() {
+  try {
+    std::vector<char> buffer(4096);
+    while (!_stopCallbackThread) {
+      std::string username;
+
+      {
+        std::lock_guard<std::mutex> usernameGuard(_usernameMutex);
+        username = _username;
+      }
 
-        PVariable json = getJson(response);
-        if (!json) return;
+      if (username.empty()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+        continue;
+      }
 
-        if (!json->arrayValue->empty() && json->arrayValue->at(0)->structValue->find("error") != json->arrayValue->at(0)->structValue->end()) {
-          json = json->arrayValue->at(0)->structValue->at("error");
-          if (json->structValue->find("type") != json->structValue->end() && json->structValue->at("type")->integerValue == 1) {
-            {
-              std::lock_guard<std::mutex> usernameGuard(_usernameMutex);
-              _username = "";
+      //The event stream is only available through the v2 API, which requires TLS.
+      BaseLib::TcpSocket socket(_bl, _hostname, "443", true, _settings->caFile, _settings->verifyCertificate);
+      socket.setReadTimeout(1000000);
+      try {
+        socket.open();
+        std::string request = "GET /eventstream/clip/v2 HTTP/1.1\r\nUser-Agent: Homegear\r\nHost: " + _hostname + "\r\nhue-application-key: " + username + "\r\nAccept: text/event-stream\r\nConnection: Keep-Alive\r\n\r\n";
+        socket.proofwrite(request);
+
+        std::string header;
+        std::string body;
+        std::string events;
+        bool headerFinished = false;
+        bool chunked = false;
+        while (!_stopCallbackThread) {
+          int32_t bytesRead = 0;
+          try {
+            bytesRead = socket.proofread(buffer.data(), buffer.size());
+          }
+          catch (const BaseLib::SocketTimeOutException &ex) {
+            continue;
+          }
+          if (bytesRead <= 0) break;
+
+          if (!headerFinished) {
+            header.append(buffer.data(), bytesRead);
+            auto headerEnd = header.find("\r\n\r\n");
+            if (headerEnd == std::string::npos) continue;
+            body = header.substr(headerEnd + 4);
+            header.resize(headerEnd);
+            if (header.compare(0, 12, "HTTP/1.1 200") != 0) {
+              _out.printWarning("Warning: Bridge did not accept event stream request. Falling back to polling. Response header was: " + header);
+              break;
             }
-            getAllData = "GET /api/" + username + " HTTP/1.1\r\nUser-Agent: Homegear\r\nHost: " + _hostname + ":" + std::to_string(_port) + "\r\nConnection: Keep-Alive\r\n\r\n";
-            _nextPoll = BaseLib::HelperFunctions::getTime() + 25000;
+            chunked = BaseLib::HelperFunctions::toLower(header).find("transfer-encoding: chunked") != std::string::npos;
+            headerFinished = true;
+            _eventStreamConnected = true;
+            _reconcileNow = true; //Reconcile everything that happened while the stream was not connected
+            _nextPoll = 0;
+            wakePollTask();
+            _out.printInfo("Info: Event stream connected.");
+          } else body.append(buffer.data(), bytesRead);
+
+          if (chunked) {
+            bool lastChunk = false;
+            while (true) {
+              auto sizeEnd = body.find("\r\n");
+              if (sizeEnd == std::string::npos) break;
+              size_t chunkSize = std::strtoul(body.c_str(), nullptr, 16);
+              if (chunkSize == 0) {
+                lastChunk = true;
+                break;
+              }
+              if (body.size() < sizeEnd + 2 + chunkSize + 2) break;
+              events.append(body, sizeEnd + 2, chunkSize);
+              body.erase(0, sizeEnd + 2 + chunkSize + 2);
+            }
+            if (lastChunk) break;
           } else {
-            if (json->structValue->find("description") != json->structValue->end()) _out.printError("Error: " + json->structValue->at("description")->stringValue);
-            else _out.printError("Unknown error during polling. Response was: " + response);
+            events.append(body);
+            body.clear();
           }
-          continue;
-        }
 
-        if (json->structValue->find("lights") != json->structValue->end()) {
-          PVariable lights = json->structValue->at("lights");
-          for (auto& light : *lights->structValue) {
-            std::string address = light.first;
-            std::shared_ptr<PhilipsHuePacket> packet(new PhilipsHuePacket(PhilipsHuePacket::Category::light, (_settings->address << 20) | BaseLib::Math::getNumber(address), 0, 1, light.second, BaseLib::HelperFunctions::getTime()));
-            raisePacketReceived(packet);
+          //Server-sent events are separated by an empty line.
+          BaseLib::HelperFunctions::stringReplace(events, "\r\n", "\n");
+          while (true) {
+            auto eventEnd = events.find("\n\n");
+            if (eventEnd == std::string::npos) break;
+            std::string event = events.substr(0, eventEnd);
+            events.erase(0, eventEnd + 2);
+
+            std::string data;
+            std::istringstream lines(event);
+            std::string line;
+            while (std::getline(lines, line)) {
+              if (line.compare(0, 5, "data:") != 0) continue;
+              line.erase(0, 5);
+              data.append(BaseLib::HelperFunctions::trim(line));
+            }
+            if (!data.empty()) processStreamEvent(data, username);
           }
         }
+      }
+      catch (const std::exception &ex) {
+        if (_eventStreamConnected) _out.printWarning("Warning: Event stream disconnected: " + std::string(ex.what()));
+        else _out.printDebug("Debug: Could not connect to event stream: " + std::string(ex.what()));
+      }
+      socket.close();
 
-        if (json->structValue->find("groups") != json->structValue->end()) {
-          PVariable groups = json->structValue->at("groups");
-          for (auto& group : *groups->structValue) {
-            std::string address = group.first;
-            std::shared_ptr<PhilipsHuePacket> packet(new PhilipsHuePacket(PhilipsHuePacket::Category::group, (_settings->address << 20) | BaseLib::Math::getNumber(address), 0, 0x80, group.second, BaseLib::HelperFunctions::getTime()));
-            raisePacketReceived(packet);
-          }
-        }
+      if (_eventStreamConnected) {
+        _eventStreamConnected = false;
+        _forcePoll = true; //Fall back to regular polling immediately
+        _nextPoll = 0;
+        wakePollTask();
+      }
 
-        _lastPacketReceived = BaseLib::HelperFunctions::getTime();
+      for (int32_t i = 0; i < 10; i++) {
+        if (_stopCallbackThread) return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
       }
-      catch (const std::exception &ex) {
-        _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  _eventStreamConnected = false;
+}
+
+void HueBridge::processStreamEvent(const std::string &data, const std::string &username) {
+  try {
+    PVariable json = _jsonDecoder->decode(data);
+    if (!json || json->type != VariableType::tArray) return;
+
+    //One event can contain several updates of the same v1 resource (e. g. "light" and "zigbee_connectivity"), so collect them first.
+    std::set<std::string> resources;
+    for (auto &container : *json->arrayValue) {
+      auto typeIterator = container->structValue->find("type");
+      if (typeIterator == container->structValue->end() || typeIterator->second->stringValue != "update") continue;
+      auto dataIterator = container->structValue->find("data");
+      if (dataIterator == container->structValue->end()) continue;
+      for (auto &element : *dataIterator->second->arrayValue) {
+        auto idIterator = element->structValue->find("id_v1");
+        if (idIterator == element->structValue->end()) continue;
+        const std::string &resource = idIterator->second->stringValue;
+        if (resource.compare(0, 8, "/lights/") == 0 || resource.compare(0, 8, "/groups/") == 0 || resource.compare(0, 9, "/sensors/") == 0) resources.emplace(resource);
       }
     }
+
+    bool dispatched = false;
+    for (auto &resource : resources) {
+      if (_stopCallbackThread) return;
+      if (dispatchResource(resource, username)) dispatched = true;
+    }
+    if (dispatched) raiseBatchEnd();
+  }
+  catch (const BaseLib::Rpc::JsonDecoderException &ex) {
+    _out.printError("Error parsing event: " + std::string(ex.what()) + ". Data was: " + data);
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+bool HueBridge::dispatchResource(const std::string &resource, const std::string &username) {
+  try {
+    auto idPosition = resource.find_last_of('/');
+    if (idPosition == std::string::npos || idPosition == 0) return false;
+    std::string address = resource.substr(idPosition + 1);
+    int32_t id = BaseLib::Math::getNumber(address);
+    PhilipsHuePacket::Category category = PhilipsHuePacket::Category::light;
+    if (resource.compare(0, 8, "/groups/") == 0) category = PhilipsHuePacket::Category::group;
+    else if (resource.compare(0, 9, "/sensors/") == 0) category = PhilipsHuePacket::Category::sensor;
+
+    std::string getData = "GET /api/" + username + resource + " HTTP/1.1\r\nUser-Agent: Homegear\r\nHost: " + _hostname + ":" + std::to_string(_port) + "\r\nConnection: Keep-Alive\r\n\r\n";
+    std::string response;
+    sendRequest(ConnectionPurpose::other, getData, response);
+    _bytesReceived += response.size();
+
+    int64_t decodeStartTime = BaseLib::HelperFunctions::getTimeMicroseconds();
+    PVariable json = getJson(response);
+    _decodeTimes.record(BaseLib::HelperFunctions::getTimeMicroseconds() - decodeStartTime);
+    if (!json || json->type != VariableType::tStruct) return false;
+
+    bool dispatched = dispatchResource(category, id, json);
+    _lastPacketReceived = BaseLib::HelperFunctions::getTime();
+    return dispatched;
   }
   catch (const std::exception &ex) {
     _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
   }
+  return false;
 }
 }
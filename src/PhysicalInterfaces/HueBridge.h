@@ -32,8 +32,15 @@
 
 #include "../PhilipsHuePacket.h"
 #include "IPhilipsHueInterface.h"
+#include "../LatencyHistogram.h"
 
+#include <array>
+#include <cmath>
+#include <deque>
+#include <future>
 #include <istream>
+#include <list>
+#include <unordered_map>
 
 namespace PhilipsHue
 {
@@ -46,28 +53,305 @@ class HueBridge  : public IPhilipsHueInterface
         void startListening();
         void stopListening();
         void sendPacket(std::shared_ptr<BaseLib::Systems::Packet> packet);
+        std::future<bool> queuePacket(std::shared_ptr<PhilipsHuePacket> packet, CommandPriority priority) override;
         int64_t lastAction() { return _lastAction; }
-        bool isOpen() override { return (bool)_client && _connected; }
+        bool isOpen() override { return !_connections.empty() && _connected; }
         void searchLights() override;
         bool userCreated() override;
         std::set<std::shared_ptr<PhilipsHuePacket>> getPeerInfo() override;
         std::set<std::shared_ptr<PhilipsHuePacket>> getGroupInfo() override;
+        PVariable getStatistics() override;
+        PVariable getMetrics() override;
     protected:
         bool _noHost = true;
         std::atomic_bool _connected{false};
         int64_t _lastAction = 0;
         uint32_t _pollingInterval = 3000;
-        int64_t _nextPoll = 0;
+        uint32_t _minPollingInterval = 1000;
+        uint32_t _maxPollingInterval = 0; //0 disables the backoff, so each endpoint is polled at least every configured interval
+        std::atomic<int64_t> _pollLatency{0}; //Moving average of the response time of polls in milliseconds
+        std::atomic<int64_t> _nextPoll{0};
+
+        //{{{ Event stream
+        bool _eventStream = false;
+        uint32_t _reconciliationInterval = 60000;
+        std::atomic_bool _eventStreamConnected{false};
+        std::thread _eventStreamThread;
+        //}}}
+
+        //{{{ Command queue
+        struct QueuedCommand {
+          std::shared_ptr<PhilipsHuePacket> packet;
+          int64_t enqueueTime = 0;
+          bool throttled = false;
+          CommandPriority priority = CommandPriority::interactive;
+          uint32_t attempts = 0;
+          int64_t nextAttempt = 0; //Failed commands are retried after one second
+          std::vector<std::promise<bool>> results; //One per queued packet merged into this command
+        };
+
+        struct CommandLane {
+          std::list<int64_t> destinations; //Destinations (see getDestination()) with queued commands in the order they are served
+          std::unordered_map<int64_t, std::deque<std::shared_ptr<QueuedCommand>>> commands;
+        };
+
+        /**
+         * The bridge only processes about 10 light commands and 1 group command per second. Commands exceeding that are delayed instead of being sent.
+         */
+        struct TokenBucket {
+          double rate = 0; //Tokens per second. 0 disables the bucket.
+          double capacity = 1;
+          double tokens = 1;
+          int64_t lastRefill = 0;
+
+          bool take(int64_t time);
+          int64_t timeUntilAvailable();
+        };
+
+        uint32_t _commandQueueSize = 100;
+        std::mutex _commandQueueMutex;
+        std::array<CommandLane, 2> _commandLanes; //Indexed by CommandPriority
+        size_t _queuedCommands = 0;
+        TokenBucket _lightBucket{10};
+        TokenBucket _groupBucket{1};
+        std::atomic<int32_t> _senderTask{-1}; //ID of the scheduler task sending the commands
+        std::unordered_map<int64_t, int64_t> _lastCommandTimes; //Indexed by destination (see getDestination())
+        std::atomic<uint64_t> _sentCommands{0};
+        std::atomic<uint64_t> _failedCommands{0};
+        std::atomic<uint64_t> _rejectedCommands{0};
+        std::atomic<uint64_t> _maxCommandQueueDepth{0};
+        std::atomic<int64_t> _commandLatencySum{0};
+        std::atomic<int64_t> _maxCommandLatency{0};
+        std::atomic<uint64_t> _interactiveCommands{0};
+        std::atomic<uint64_t> _bulkCommands{0};
+        std::atomic<uint64_t> _throttledCommands{0};
+        std::atomic<uint64_t> _mergedCommands{0};
+        std::atomic<uint64_t> _supersededValues{0};
+        std::atomic<uint64_t> _appliedCommandResponses{0};
+        //}}}
+
+        //{{{ Metrics
+        LatencyHistogram _pollRoundTripTimes;
+        LatencyHistogram _commandRoundTripTimes;
+        LatencyHistogram _decodeTimes;
+        LatencyHistogram _dispatchTimes;
+        LatencyHistogram _reconnectTimes; //Requests that had to open their connection first
+        std::atomic<uint64_t> _pollRetries{0};
+        std::atomic<uint64_t> _pollErrors{0};
+        std::atomic<uint64_t> _commandRetries{0};
+        std::atomic<uint64_t> _bytesReceived{0};
+        std::atomic<uint64_t> _packetsRaised{0};
+        //}}}
+
+        //{{{ Change detection
+        std::mutex _fingerprintsMutex;
+        std::array<std::unordered_map<int32_t, size_t>, 3> _fingerprints; //Indexed by PhilipsHuePacket::Category
+        std::atomic<uint64_t> _dispatchedResources{0};
+        std::atomic<uint64_t> _skippedResources{0};
+        std::mutex _sensorStatesMutex;
+        std::unordered_map<int32_t, std::string> _sensorStates; //Encoded "state" of each sensor
+        //}}}
+
+        //{{{ Polling
+        std::atomic<int32_t> _pollTask{-1}; //ID of the scheduler task polling the bridge
+        std::string _pollUsername; //Only used by the poll task
+        struct PollEndpoint {
+          PhilipsHuePacket::Category category = PhilipsHuePacket::Category::light;
+          std::string path; //Relative to "/api/<username>". Empty for the full state.
+          std::string intervalSetting; //Name of the family setting overriding "interval"
+          uint32_t interval = 0; //The configured interval. 0 disables polling of the endpoint.
+          uint32_t minInterval = 0;
+          uint32_t maxInterval = 0;
+          uint32_t currentInterval = 0; //Adapted to the activity between "minInterval" and "maxInterval"
+          bool changed = false; //Set when the last poll dispatched at least one resource
+          int64_t nextPoll = 0;
+          uint32_t failedAttempts = 0; //Failed requests in a row. Failed requests are retried after one second up to 5 times.
+          uint32_t digest = 0; //CRC32C of the last processed response
+          int64_t digestGeneration = -1;
+        };
+
+        std::array<PollEndpoint, 3> _pollEndpoints; //Lights, groups and sensors
+        PollEndpoint _reconciliationEndpoint;
+        std::atomic_bool _forcePoll{false}; //Poll all endpoints regardless of their interval
+        std::atomic_bool _reconcileNow{false};
+        std::atomic<int64_t> _commandGeneration{0}; //Incremented on every command, so a poll started before a command is never used as reference.
+        std::atomic<uint64_t> _polls{0};
+        std::atomic<uint64_t> _shortCircuitedPolls{0};
+        //}}}
+
+        //{{{ Connection pool
+        /**
+         * Commands, polls and everything else (event stream lookups, searches, ...) each use their own connection, so a command never has to wait for a large poll response.
+         */
+        enum class ConnectionPurpose {
+          command = 0,
+          poll = 1,
+          other = 2
+        };
+
+        struct PooledConnection {
+          std::mutex mutex;
+          std::unique_ptr<BaseLib::HttpClient> client;
+          uint32_t consecutiveFailures = 0; //Protected by "mutex"
+          std::atomic<uint64_t> requests{0};
+          std::atomic<uint64_t> failures{0};
+          std::atomic<uint64_t> reconnects{0}; //Requests that successfully reopened a connection that was closed before
+          std::atomic<uint64_t> waits{0}; //Requests that had to wait for another request on this connection
+          std::atomic<int64_t> busyTime{0}; //Sum of the request durations in milliseconds
+        };
+
+        uint32_t _connectionPoolSize = 3;
+        std::vector<std::unique_ptr<PooledConnection>> _connections; //Created in the constructor and never changed afterwards
+        std::atomic<uint32_t> _nextConnection{0};
+        int64_t _connectionPoolStartTime = 0;
+        //}}}
+
         int32_t _port = 80;
-        std::unique_ptr<BaseLib::HttpClient> _client;
         std::unique_ptr<BaseLib::Rpc::JsonEncoder> _jsonEncoder;
         std::unique_ptr<BaseLib::Rpc::JsonDecoder> _jsonDecoder;
+        const std::vector<std::string> _pollMembers{"lights", "groups"};
         std::mutex _usernameMutex;
         std::string _username;
 
-        void listen();
+        /**
+         * Scheduler task polling all endpoints that are due.
+         *
+         * @return The time the task needs to run again.
+         */
+        int64_t pollDueEndpoints();
+
+        /**
+         * Removes a task from the scheduler and waits for it to finish.
+         */
+        void removeTask(std::atomic<int32_t>& task);
+
+        /**
+         * Makes the poll task recalculate when the next endpoint is due. Needs to be called after "_nextPoll", "_forcePoll" or "_reconcileNow" were changed to poll earlier.
+         */
+        void wakePollTask();
+
+        /**
+         * Sends a request on the pool connection for the given purpose. Connections failing to send are closed, so the next request reconnects.
+         *
+         * @throws Exception The exceptions of BaseLib::HttpClient are passed on.
+         */
+        template<typename Response> void sendRequest(ConnectionPurpose purpose, const std::string& request, Response& response);
+
+        /**
+         * Scheduler task sending the next queued command that may be sent now.
+         *
+         * @return The time the task needs to run again or 0 when the queue is empty.
+         */
+        int64_t sendNextCommand();
+        void stopSender();
+
+        /**
+         * Removes the next command that may be sent now from the queue. Must be called with "_commandQueueMutex" locked.
+         *
+         * @param[out] waitTime When no command may be sent, the time in milliseconds until the next one might be sendable.
+         * @return The command to send or nullptr.
+         */
+        std::shared_ptr<QueuedCommand> getNextCommand(int64_t& waitTime);
+
+        /**
+         * Lights and groups have separate ID ranges, so the destination address of a command alone doesn't identify the resource.
+         *
+         * @return The category and the destination address of the packet combined.
+         */
+        static int64_t getDestination(const std::shared_ptr<PhilipsHuePacket>& packet);
+
+        /**
+         * Merges a new packet into a command that was not sent yet. Values of the new packet replace values of the pending command. Commands with different transition times or effects, with alerts or increments and switching off a light while the other command sets values are not merged. Must be called with "_commandQueueMutex" locked.
+         *
+         * @return Returns "true" when the packet was merged. In that case it must not be queued.
+         */
+        bool mergeCommand(std::shared_ptr<QueuedCommand>& pendingCommand, std::shared_ptr<PhilipsHuePacket>& packet);
+
+        /**
+         * Sends one command to the bridge. Blocks until the bridge responded or the request failed.
+         *
+         * @param lastAttempt When "false", failed requests are not logged and "retry" is set instead.
+         * @param[out] retry Set to "true" when the request failed and should be retried.
+         * @return Returns "true" when the bridge accepted the command.
+         */
+        bool sendCommand(std::shared_ptr<PhilipsHuePacket>& packet, bool lastAttempt, bool& retry);
+
+        /**
+         * Raises a packet with the values the bridge confirmed in its response to a command, e. g. [{"success":{"/lights/3/state/bri":200}}].
+         *
+         * @return Returns "false" when the response doesn't contain any applied value.
+         */
+        bool applyCommandResponse(std::shared_ptr<PhilipsHuePacket>& packet, const PVariable& response);
+
+        /**
+         * Requests one endpoint from the bridge and dispatches all changed resources. Makes only one attempt: When the request fails, "endpoint.failedAttempts" is incremented and the caller needs to retry.
+         *
+         * @param endpoint The endpoint to poll.
+         * @param username The user name to use. Cleared when the bridge doesn't accept it anymore.
+         * @return Returns "false" when polling should stop.
+         */
+        bool poll(PollEndpoint& endpoint, std::string& username);
+
+        /**
+         * Raises packets for all changed resources.
+         *
+         * @return The number of dispatched resources.
+         */
+        size_t dispatchResources(PhilipsHuePacket::Category category, const PVariable& resources);
+        bool dispatchResource(PhilipsHuePacket::Category category, int32_t id, const PVariable& json);
+        int32_t getResourceAddress(PhilipsHuePacket::Category category, int32_t id);
+
+        /**
+         * Checks if the state of a sensor changed since the last call. Every state change (e. g. a button press or a presence change) is reported exactly once. The first state seen after startup is not reported.
+         *
+         * @param address The address of the sensor.
+         * @param json The JSON of the sensor as returned by the bridge.
+         * @return Returns "true" when the sensor has a new event.
+         */
+        bool sensorEventOccurred(int32_t address, const PVariable& json);
         void createUser();
         PVariable getJson(std::string& jsonString);
+
+        /**
+         * Decodes only the given top level members of a JSON object. All other members are skipped without being decoded. Falls back to decoding the whole document when it is not an object (e. g. on errors).
+         */
+        PVariable getJson(std::string& jsonString, const std::vector<std::string>& members);
+
+        /**
+         * Keeps a connection to the bridge's event stream ("/eventstream/clip/v2") open and dispatches every resource
+         * change as soon as it is announced. While the stream is connected, listen() only polls every
+         * "_reconciliationInterval" milliseconds to catch anything the stream might have missed.
+         */
+        void eventStream();
+
+        /**
+         * Processes the "data" field of one server-sent event.
+         *
+         * @param data The JSON array with the event containers as sent by the bridge.
+         * @param username The user name to use for requests to the bridge.
+         */
+        void processStreamEvent(const std::string& data, const std::string& username);
+
+        /**
+         * Requests a single resource from the bridge and raises a packet for it.
+         *
+         * @param resource The v1 path of the resource, e. g. "/lights/3" or "/groups/1".
+         * @param username The user name to use for requests to the bridge.
+         * @return Returns "true" when a packet was raised.
+         */
+        bool dispatchResource(const std::string& resource, const std::string& username);
+
+        /**
+         * Compares the fingerprint of a resource with the one from the last call and stores the new fingerprint.
+         *
+         * @param category The category of the resource.
+         * @param address The address of the resource.
+         * @param json The JSON of the resource as returned by the bridge.
+         * @return Returns "false" when the resource didn't change since the last call. In that case the resource doesn't need to be dispatched.
+         */
+        bool resourceChanged(PhilipsHuePacket::Category category, int32_t address, const PVariable& json);
+        void forgetFingerprint(PhilipsHuePacket::Category category, int32_t address);
+        void forgetFingerprints();
 };
 
 }
@@ -48,4 +48,16 @@ IPhilipsHueInterface::~IPhilipsHueInterface()
 
 }
 
+void IPhilipsHueInterface::raiseBatchEnd()
+{
+	try
+	{
+		raisePacketReceived(std::make_shared<PhilipsHuePacket>(PhilipsHuePacket::Category::light, _settings->address << 20, 0, HUE_BATCH_END_MESSAGE_TYPE, PVariable(), BaseLib::HelperFunctions::getTime()));
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
 }
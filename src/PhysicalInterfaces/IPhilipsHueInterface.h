@@ -33,6 +33,8 @@
 #include <homegear-base/BaseLib.h>
 #include "../PhilipsHuePacket.h"
 
+#include <future>
+
 namespace PhilipsHue {
 
 class IPhilipsHueInterface : public BaseLib::Systems::IPhysicalInterface
@@ -46,8 +48,37 @@ public:
 	virtual std::set<std::shared_ptr<PhilipsHuePacket>> getPeerInfo() { return std::set<std::shared_ptr<PhilipsHuePacket>>(); }
 	virtual std::set<std::shared_ptr<PhilipsHuePacket>> getGroupInfo() { return std::set<std::shared_ptr<PhilipsHuePacket>>(); }
 	virtual void sendPacket(std::shared_ptr<BaseLib::Systems::Packet> packet) {}
+
+	enum class CommandPriority
+	{
+		interactive = 0,
+		bulk = 1 //E. g. commands from scripts or flows
+	};
+
+	/**
+	 * Queues a packet for sending and returns immediately.
+	 *
+	 * @param priority Interactive commands are sent before bulk commands.
+	 * @return The future is set to "true" once the packet was sent successfully and to "false" when sending failed.
+	 */
+	virtual std::future<bool> queuePacket(std::shared_ptr<PhilipsHuePacket> packet, CommandPriority priority) { sendPacket(packet); std::promise<bool> result; result.set_value(true); return result.get_future(); }
+
+	/**
+	 * Returns interface specific counters as a struct.
+	 */
+	virtual PVariable getStatistics() { return std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct); }
+
+	/**
+	 * Returns latency histograms (in microseconds) and error counters of the interface as a struct.
+	 */
+	virtual PVariable getMetrics() { return std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct); }
 protected:
 	BaseLib::Output _out;
+
+	/**
+	 * Marks the end of the packets of one poll cycle or event, so the central can deliver their events as one batch.
+	 */
+	void raiseBatchEnd();
 };
 
 }
@@ -0,0 +1,655 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+
+#include "SimulatedHueBridge.h"
+#include "../GD.h"
+
+#include <ctime>
+
+namespace PhilipsHue {
+SimulatedHueBridge::SimulatedHueBridge(std::shared_ptr<BaseLib::Systems::PhysicalInterfaceSettings> settings) : IPhilipsHueInterface(settings) {
+  _out.init(GD::bl);
+  _out.setPrefix(GD::out.getPrefix() + "Simulated hue bridge \"" + settings->id + "\": ");
+
+  std::string settingName = "simulatedlights";
+  auto setting = GD::family->getFamilySetting(settingName);
+  if (setting && setting->integerValue >= 0) _lightCount = (uint32_t)setting->integerValue;
+  if (_lightCount >= HUE_SENSOR_ADDRESS_OFFSET) _lightCount = HUE_SENSOR_ADDRESS_OFFSET - 1; //Higher IDs would get sensor addresses
+
+  settingName = "simulatedgroups";
+  setting = GD::family->getFamilySetting(settingName);
+  if (setting && setting->integerValue >= 0) _groupCount = (uint32_t)setting->integerValue;
+  if (_groupCount > 0xFFFFF) _groupCount = 0xFFFFF;
+
+  settingName = "simulatedsensors";
+  setting = GD::family->getFamilySetting(settingName);
+  if (setting && setting->integerValue >= 0) _sensorCount = (uint32_t)setting->integerValue;
+  if (_sensorCount >= HUE_SENSOR_ADDRESS_OFFSET) _sensorCount = HUE_SENSOR_ADDRESS_OFFSET - 1;
+
+  settingName = "simulatedlatency";
+  setting = GD::family->getFamilySetting(settingName);
+  if (setting && setting->integerValue >= 0) _latency = (uint32_t)setting->integerValue;
+
+  settingName = "simulatedfailurerate";
+  setting = GD::family->getFamilySetting(settingName);
+  if (setting && setting->integerValue >= 0) _failureRate = (uint32_t)setting->integerValue;
+  if (_failureRate > 100) _failureRate = 100;
+
+  settingName = "simulatedchangerate";
+  setting = GD::family->getFamilySetting(settingName);
+  if (setting && setting->integerValue >= 0) _changeRate = (uint32_t)setting->integerValue;
+
+  settingName = "simulatedsensoreventrate";
+  setting = GD::family->getFamilySetting(settingName);
+  if (setting && setting->integerValue >= 0) _sensorEventRate = (uint32_t)setting->integerValue;
+
+  createState();
+}
+
+SimulatedHueBridge::~SimulatedHueBridge() {
+  try {
+    removeTask(_simulationTask);
+    removeTask(_commandTask);
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void SimulatedHueBridge::startListening() {
+  try {
+    stopListening();
+    _myAddress = _settings->address;
+    if (GD::scheduler) {
+      {
+        std::lock_guard<std::mutex> stateGuard(_stateMutex);
+        _lastTick = BaseLib::HelperFunctions::getTime();
+      }
+      _simulationTask = GD::scheduler->add(std::bind(&SimulatedHueBridge::simulate, this), BaseLib::HelperFunctions::getTime());
+      _commandTask = GD::scheduler->add(std::bind(&SimulatedHueBridge::processCommands, this), 0);
+    }
+    _out.printInfo("Info: Simulating " + std::to_string(_lightCount) + " lights, " + std::to_string(_groupCount) + " groups and " + std::to_string(_sensorCount) + " sensors.");
+    IPhysicalInterface::startListening();
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void SimulatedHueBridge::stopListening() {
+  try {
+    removeTask(_simulationTask);
+    removeTask(_commandTask);
+
+    std::multimap<int64_t, std::shared_ptr<PendingCommand>> pendingCommands;
+    {
+      std::lock_guard<std::mutex> commandsGuard(_commandsMutex);
+      pendingCommands.swap(_pendingCommands);
+    }
+    for (auto &command : pendingCommands) {
+      command.second->result.set_value(false);
+    }
+    IPhysicalInterface::stopListening();
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void SimulatedHueBridge::removeTask(std::atomic<int32_t> &task) {
+  int32_t id = task.exchange(-1);
+  if (id != -1 && GD::scheduler) GD::scheduler->remove(id);
+}
+
+void SimulatedHueBridge::createState() {
+  try {
+    std::lock_guard<std::mutex> stateGuard(_stateMutex);
+    _lights.clear();
+    _groups.clear();
+    _sensors.clear();
+    _groupsOfLight.clear();
+    _transitions.clear();
+
+    for (int32_t id = 1; id <= (int32_t)_lightCount; id++) {
+      auto state = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+      state->structValue->emplace("on", std::make_shared<BaseLib::Variable>(false));
+      state->structValue->emplace("bri", std::make_shared<BaseLib::Variable>(254));
+      state->structValue->emplace("hue", std::make_shared<BaseLib::Variable>(8418));
+      state->structValue->emplace("sat", std::make_shared<BaseLib::Variable>(140));
+      auto xy = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tArray);
+      xy->arrayValue->push_back(std::make_shared<BaseLib::Variable>(0.4573));
+      xy->arrayValue->push_back(std::make_shared<BaseLib::Variable>(0.41));
+      state->structValue->emplace("xy", xy);
+      state->structValue->emplace("ct", std::make_shared<BaseLib::Variable>(366));
+      state->structValue->emplace("alert", std::make_shared<BaseLib::Variable>(std::string("none")));
+      state->structValue->emplace("effect", std::make_shared<BaseLib::Variable>(std::string("none")));
+      state->structValue->emplace("colormode", std::make_shared<BaseLib::Variable>(std::string("ct")));
+      state->structValue->emplace("reachable", std::make_shared<BaseLib::Variable>(true));
+
+      auto light = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+      light->structValue->emplace("state", state);
+      light->structValue->emplace("type", std::make_shared<BaseLib::Variable>(std::string("Extended color light")));
+      light->structValue->emplace("name", std::make_shared<BaseLib::Variable>("Simulated light " + std::to_string(id)));
+      light->structValue->emplace("modelid", std::make_shared<BaseLib::Variable>(std::string("LCT015")));
+      light->structValue->emplace("manufacturername", std::make_shared<BaseLib::Variable>(std::string("Philips")));
+      light->structValue->emplace("uniqueid", std::make_shared<BaseLib::Variable>("00:17:88:01:" + BaseLib::HelperFunctions::getHexString((_settings->address << 20) | id, 8) + "-0b"));
+      light->structValue->emplace("swversion", std::make_shared<BaseLib::Variable>(std::string("1.46.13_r26312")));
+      _lights.emplace(id, light);
+    }
+
+    //Lights are distributed round robin, so every light is in exactly one group.
+    std::map<int32_t, PVariable> groupLights;
+    for (int32_t id = 1; id <= (int32_t)_groupCount; id++) {
+      groupLights.emplace(id, std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tArray));
+    }
+    if (_groupCount > 0) {
+      for (auto &light : _lights) {
+        int32_t groupId = ((light.first - 1) % (int32_t)_groupCount) + 1;
+        groupLights.at(groupId)->arrayValue->push_back(std::make_shared<BaseLib::Variable>(std::to_string(light.first)));
+        _groupsOfLight[light.first].push_back(groupId);
+      }
+    }
+
+    for (int32_t id = 1; id <= (int32_t)_groupCount; id++) {
+      auto action = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+      action->structValue->emplace("on", std::make_shared<BaseLib::Variable>(false));
+      action->structValue->emplace("bri", std::make_shared<BaseLib::Variable>(254));
+      action->structValue->emplace("ct", std::make_shared<BaseLib::Variable>(366));
+      action->structValue->emplace("colormode", std::make_shared<BaseLib::Variable>(std::string("ct")));
+
+      auto state = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+      state->structValue->emplace("all_on", std::make_shared<BaseLib::Variable>(false));
+      state->structValue->emplace("any_on", std::make_shared<BaseLib::Variable>(false));
+
+      auto group = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+      group->structValue->emplace("name", std::make_shared<BaseLib::Variable>("Simulated group " + std::to_string(id)));
+      group->structValue->emplace("lights", groupLights.at(id));
+      group->structValue->emplace("type", std::make_shared<BaseLib::Variable>(std::string("Room")));
+      group->structValue->emplace("action", action);
+      group->structValue->emplace("state", state);
+      _groups.emplace(id, group);
+    }
+
+    //Odd IDs are dimmer switches, even IDs motion sensors.
+    std::string timestamp = getTimestamp();
+    for (int32_t id = 1; id <= (int32_t)_sensorCount; id++) {
+      bool isSwitch = (id & 1) == 1;
+      auto state = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+      if (isSwitch) state->structValue->emplace("buttonevent", std::make_shared<BaseLib::Variable>(1002));
+      else {
+        state->structValue->emplace("presence", std::make_shared<BaseLib::Variable>(false));
+        state->structValue->emplace("lightlevel", std::make_shared<BaseLib::Variable>(12000));
+        state->structValue->emplace("dark", std::make_shared<BaseLib::Variable>(false));
+        state->structValue->emplace("daylight", std::make_shared<BaseLib::Variable>(true));
+        state->structValue->emplace("temperature", std::make_shared<BaseLib::Variable>(2100));
+      }
+      state->structValue->emplace("lastupdated", std::make_shared<BaseLib::Variable>(timestamp));
+
+      auto config = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+      config->structValue->emplace("on", std::make_shared<BaseLib::Variable>(true));
+      config->structValue->emplace("battery", std::make_shared<BaseLib::Variable>(100));
+      config->structValue->emplace("reachable", std::make_shared<BaseLib::Variable>(true));
+
+      auto sensor = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+      sensor->structValue->emplace("state", state);
+      sensor->structValue->emplace("config", config);
+      sensor->structValue->emplace("name", std::make_shared<BaseLib::Variable>("Simulated sensor " + std::to_string(id)));
+      sensor->structValue->emplace("type", std::make_shared<BaseLib::Variable>(std::string(isSwitch ? "ZLLSwitch" : "ZLLPresence")));
+      sensor->structValue->emplace("modelid", std::make_shared<BaseLib::Variable>(std::string(isSwitch ? "RWL021" : "SML001")));
+      sensor->structValue->emplace("manufacturername", std::make_shared<BaseLib::Variable>(std::string("Philips")));
+      sensor->structValue->emplace("swversion", std::make_shared<BaseLib::Variable>(std::string("6.1.1.28573")));
+      _sensors.emplace(id, sensor);
+    }
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+PVariable SimulatedHueBridge::copyJson(const PVariable &json) {
+  if (!json) return json;
+  if (json->type == BaseLib::VariableType::tStruct) {
+    auto copy = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+    for (auto &element : *json->structValue) {
+      copy->structValue->emplace(element.first, copyJson(element.second));
+    }
+    return copy;
+  } else if (json->type == BaseLib::VariableType::tArray) {
+    auto copy = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tArray);
+    copy->arrayValue->reserve(json->arrayValue->size());
+    for (auto &element : *json->arrayValue) {
+      copy->arrayValue->push_back(copyJson(element));
+    }
+    return copy;
+  }
+  return std::make_shared<BaseLib::Variable>(*json);
+}
+
+int32_t SimulatedHueBridge::getAddress(PhilipsHuePacket::Category category, int32_t id) {
+  if (category == PhilipsHuePacket::Category::sensor) id |= HUE_SENSOR_ADDRESS_OFFSET;
+  return (_settings->address << 20) | id;
+}
+
+std::string SimulatedHueBridge::getTimestamp() {
+  std::time_t time = BaseLib::HelperFunctions::getTimeSeconds();
+  std::tm timeStruct{};
+  gmtime_r(&time, &timeStruct);
+  char buffer[32];
+  std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S", &timeStruct);
+  return std::string(buffer);
+}
+
+void SimulatedHueBridge::sendPacket(std::shared_ptr<BaseLib::Systems::Packet> packet) {
+  queuePacket(std::dynamic_pointer_cast<PhilipsHuePacket>(packet), CommandPriority::interactive);
+}
+
+std::future<bool> SimulatedHueBridge::queuePacket(std::shared_ptr<PhilipsHuePacket> packet, CommandPriority priority) {
+  std::promise<bool> promise;
+  std::future<bool> result = promise.get_future();
+  try {
+    if (!packet || !packet->getJson() || _commandTask == -1) {
+      if (!packet) _out.printWarning("Warning: Packet was nullptr.");
+      promise.set_value(false);
+      return result;
+    }
+
+    auto command = std::make_shared<PendingCommand>();
+    command->packet = packet;
+    command->result = std::move(promise);
+    command->enqueueTime = BaseLib::HelperFunctions::getTimeMicroseconds();
+
+    //Like on a real bridge the latency varies, so commands are answered with a jitter of +-50 %.
+    int64_t latency = _latency == 0 ? 0 : BaseLib::HelperFunctions::getRandomNumber(_latency / 2, _latency + _latency / 2);
+    {
+      std::lock_guard<std::mutex> commandsGuard(_commandsMutex);
+      _pendingCommands.emplace(BaseLib::HelperFunctions::getTime() + latency, command);
+    }
+    int32_t id = _commandTask;
+    if (id != -1 && GD::scheduler) GD::scheduler->wake(id);
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return result;
+}
+
+int64_t SimulatedHueBridge::processCommands() {
+  try {
+    std::vector<std::shared_ptr<PendingCommand>> dueCommands;
+    int64_t nextTime = 0;
+    {
+      std::lock_guard<std::mutex> commandsGuard(_commandsMutex);
+      int64_t time = BaseLib::HelperFunctions::getTime();
+      auto commandIterator = _pendingCommands.begin();
+      while (commandIterator != _pendingCommands.end() && commandIterator->first <= time) {
+        dueCommands.push_back(commandIterator->second);
+        commandIterator = _pendingCommands.erase(commandIterator);
+      }
+      if (!_pendingCommands.empty()) nextTime = _pendingCommands.begin()->first;
+    }
+
+    for (auto &command : dueCommands) {
+      bool success = false;
+      if (BaseLib::HelperFunctions::getRandomNumber(0, 99) >= (int32_t)_failureRate) {
+        std::vector<std::shared_ptr<PhilipsHuePacket>> packets;
+        {
+          std::lock_guard<std::mutex> stateGuard(_stateMutex);
+          success = applyCommand(command->packet, packets);
+        }
+        for (auto &packet : packets) {
+          raisePacketReceived(packet);
+          _packetsRaised++;
+        }
+        if (!packets.empty()) raiseBatchEnd();
+      }
+
+      if (success) _sentCommands++;
+      else {
+        _failedCommands++;
+        _out.printDebug("Debug: Simulated failure of command to " + BaseLib::HelperFunctions::getHexString(command->packet->destinationAddress()) + ".");
+      }
+      _commandRoundTripTimes.record(BaseLib::HelperFunctions::getTimeMicroseconds() - command->enqueueTime);
+      command->result.set_value(success);
+    }
+    return nextTime;
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return BaseLib::HelperFunctions::getTime() + _tickInterval;
+}
+
+bool SimulatedHueBridge::applyCommand(std::shared_ptr<PhilipsHuePacket> &packet, std::vector<std::shared_ptr<PhilipsHuePacket>> &packets) {
+  try {
+    int32_t id = packet->destinationAddress() & 0xFFFFF;
+    PVariable values = packet->getJson();
+    if (values->type != BaseLib::VariableType::tStruct) return false;
+    int64_t time = BaseLib::HelperFunctions::getTime();
+    std::set<int32_t> changedLights;
+
+    if (packet->getCategory() == PhilipsHuePacket::Category::light) {
+      if (_lights.find(id) == _lights.end()) return false;
+      setLightState(id, values, time);
+      changedLights.insert(id);
+    } else if (packet->getCategory() == PhilipsHuePacket::Category::group) {
+      if (id == 0) {
+        //Group 0 always contains all lights of the bridge.
+        for (auto &light : _lights) {
+          setLightState(light.first, values, time);
+          changedLights.insert(light.first);
+        }
+      } else {
+        auto groupIterator = _groups.find(id);
+        if (groupIterator == _groups.end()) return false;
+        for (auto &member : *groupIterator->second->structValue->at("lights")->arrayValue) {
+          int32_t lightId = BaseLib::Math::getNumber(member->stringValue);
+          if (_lights.find(lightId) == _lights.end()) continue;
+          setLightState(lightId, values, time);
+          changedLights.insert(lightId);
+        }
+
+        auto &action = groupIterator->second->structValue->at("action");
+        for (auto &value : *values->structValue) {
+          if (value.first == "transitiontime") continue;
+          (*action->structValue)[value.first] = copyJson(value.second);
+        }
+        packets.push_back(std::make_shared<PhilipsHuePacket>(PhilipsHuePacket::Category::group, getAddress(PhilipsHuePacket::Category::group, id), 0, 0x80, copyJson(groupIterator->second), time));
+      }
+    } else return false;
+
+    collectPackets(changedLights, packets);
+    return true;
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return false;
+}
+
+void SimulatedHueBridge::setLightState(int32_t id, const PVariable &values, int64_t time) {
+  try {
+    auto &state = _lights.at(id)->structValue->at("state");
+    int64_t transitionTime = 4; //Default of the bridge in 100 ms steps
+    auto transitionTimeIterator = values->structValue->find("transitiontime");
+    if (transitionTimeIterator != values->structValue->end()) transitionTime = transitionTimeIterator->second->integerValue;
+
+    Transition transition;
+    transition.startTime = time;
+    transition.duration = transitionTime * 100;
+    for (auto &value : *values->structValue) {
+      if (value.first == "bri" || value.first == "hue" || value.first == "sat" || value.first == "ct") {
+        if (transition.duration > 0) {
+          transition.start[value.first] = state->structValue->at(value.first)->integerValue;
+          transition.target[value.first] = value.second->integerValue;
+        } else (*state->structValue)[value.first] = std::make_shared<BaseLib::Variable>(value.second->integerValue);
+        if (value.first != "bri") (*state->structValue)["colormode"] = std::make_shared<BaseLib::Variable>(std::string(value.first == "ct" ? "ct" : "hs"));
+      } else if (value.first == "xy") {
+        if (value.second->arrayValue->size() != 2) continue;
+        if (transition.duration > 0) {
+          auto &xy = state->structValue->at("xy");
+          transition.start["x"] = xy->arrayValue->at(0)->floatValue;
+          transition.start["y"] = xy->arrayValue->at(1)->floatValue;
+          transition.target["x"] = value.second->arrayValue->at(0)->floatValue;
+          transition.target["y"] = value.second->arrayValue->at(1)->floatValue;
+        } else (*state->structValue)["xy"] = copyJson(value.second);
+        (*state->structValue)["colormode"] = std::make_shared<BaseLib::Variable>(std::string("xy"));
+      } else if (value.first == "on" || value.first == "alert" || value.first == "effect") {
+        (*state->structValue)[value.first] = copyJson(value.second);
+      }
+    }
+
+    //A new transition replaces the running one. Values of the running transition not contained in the new one stay where they are.
+    if (transition.target.empty()) return;
+    if (transition.target.find("hue") != transition.target.end() && std::abs(transition.target["hue"] - transition.start["hue"]) > 32768) {
+      //The shorter way around the color wheel.
+      if (transition.target["hue"] > transition.start["hue"]) transition.start["hue"] += 65536;
+      else transition.target["hue"] += 65536;
+    }
+    _transitions[id] = std::move(transition);
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void SimulatedHueBridge::advanceTransitions(int64_t time, std::set<int32_t> &changedLights) {
+  try {
+    for (auto transitionIterator = _transitions.begin(); transitionIterator != _transitions.end();) {
+      auto &transition = transitionIterator->second;
+      auto &state = _lights.at(transitionIterator->first)->structValue->at("state");
+      double progress = transition.duration <= 0 ? 1.0 : std::min(1.0, (double)(time - transition.startTime) / (double)transition.duration);
+      for (auto &target : transition.target) {
+        double value = transition.start.at(target.first) + (target.second - transition.start.at(target.first)) * progress;
+        if (target.first == "x" || target.first == "y") {
+          state->structValue->at("xy")->arrayValue->at(target.first == "x" ? 0 : 1) = std::make_shared<BaseLib::Variable>(std::round(value * 10000) / 10000);
+        } else {
+          int32_t integerValue = (int32_t)std::lround(value);
+          if (target.first == "hue") integerValue %= 65536;
+          (*state->structValue)[target.first] = std::make_shared<BaseLib::Variable>(integerValue);
+        }
+      }
+      changedLights.insert(transitionIterator->first);
+
+      if (progress >= 1.0) transitionIterator = _transitions.erase(transitionIterator);
+      else ++transitionIterator;
+    }
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void SimulatedHueBridge::collectPackets(const std::set<int32_t> &changedLights, std::vector<std::shared_ptr<PhilipsHuePacket>> &packets) {
+  try {
+    int64_t time = BaseLib::HelperFunctions::getTime();
+    std::set<int32_t> changedGroups;
+    for (auto lightId : changedLights) {
+      packets.push_back(std::make_shared<PhilipsHuePacket>(PhilipsHuePacket::Category::light, getAddress(PhilipsHuePacket::Category::light, lightId), 0, 1, copyJson(_lights.at(lightId)), time));
+      auto groupsIterator = _groupsOfLight.find(lightId);
+      if (groupsIterator != _groupsOfLight.end()) changedGroups.insert(groupsIterator->second.begin(), groupsIterator->second.end());
+    }
+
+    for (auto groupId : changedGroups) {
+      auto &group = _groups.at(groupId);
+      bool allOn = true;
+      bool anyOn = false;
+      for (auto &lightId : *group->structValue->at("lights")->arrayValue) {
+        auto lightIterator = _lights.find(BaseLib::Math::getNumber(lightId->stringValue));
+        if (lightIterator == _lights.end()) continue;
+        bool on = lightIterator->second->structValue->at("state")->structValue->at("on")->booleanValue;
+        allOn = allOn && on;
+        anyOn = anyOn || on;
+      }
+      auto &state = group->structValue->at("state");
+      if (state->structValue->at("all_on")->booleanValue == allOn && state->structValue->at("any_on")->booleanValue == anyOn) continue;
+      (*state->structValue)["all_on"] = std::make_shared<BaseLib::Variable>(allOn);
+      (*state->structValue)["any_on"] = std::make_shared<BaseLib::Variable>(anyOn);
+      packets.push_back(std::make_shared<PhilipsHuePacket>(PhilipsHuePacket::Category::group, getAddress(PhilipsHuePacket::Category::group, groupId), 0, 0x80, copyJson(group), time));
+    }
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void SimulatedHueBridge::triggerSensor(int32_t id) {
+  try {
+    auto &state = _sensors.at(id)->structValue->at("state");
+    if ((id & 1) == 1) {
+      //Short release of one of the four buttons.
+      (*state->structValue)["buttonevent"] = std::make_shared<BaseLib::Variable>(BaseLib::HelperFunctions::getRandomNumber(1, 4) * 1000 + 2);
+    } else {
+      bool presence = !state->structValue->at("presence")->booleanValue;
+      (*state->structValue)["presence"] = std::make_shared<BaseLib::Variable>(presence);
+      (*state->structValue)["lightlevel"] = std::make_shared<BaseLib::Variable>(BaseLib::HelperFunctions::getRandomNumber(0, 30000));
+    }
+    (*state->structValue)["lastupdated"] = std::make_shared<BaseLib::Variable>(getTimestamp());
+    _sensorEvents++;
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+int64_t SimulatedHueBridge::simulate() {
+  try {
+    int64_t startTime = BaseLib::HelperFunctions::getTimeMicroseconds();
+    int64_t time = BaseLib::HelperFunctions::getTime();
+    std::vector<std::shared_ptr<PhilipsHuePacket>> packets;
+    {
+      std::lock_guard<std::mutex> stateGuard(_stateMutex);
+      int64_t elapsedTime = std::max((int64_t)0, time - _lastTick);
+      _lastTick = time;
+
+      std::set<int32_t> changedLights;
+      advanceTransitions(time, changedLights);
+
+      //Changes made with the hue app or a light switch.
+      _pendingChanges += (double)_changeRate * (double)elapsedTime / 1000.0;
+      while (_pendingChanges >= 1.0) {
+        _pendingChanges -= 1.0;
+        if (_lights.empty()) continue;
+        int32_t id = BaseLib::HelperFunctions::getRandomNumber(1, (int32_t)_lights.size());
+        auto values = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+        if (BaseLib::HelperFunctions::getRandomNumber(0, 1) == 0) {
+          bool on = _lights.at(id)->structValue->at("state")->structValue->at("on")->booleanValue;
+          values->structValue->emplace("on", std::make_shared<BaseLib::Variable>(!on));
+        } else {
+          values->structValue->emplace("bri", std::make_shared<BaseLib::Variable>(BaseLib::HelperFunctions::getRandomNumber(1, 254)));
+          values->structValue->emplace("ct", std::make_shared<BaseLib::Variable>(BaseLib::HelperFunctions::getRandomNumber(153, 500)));
+        }
+        setLightState(id, values, time);
+        changedLights.insert(id);
+        _externalChanges++;
+      }
+      collectPackets(changedLights, packets);
+
+      _pendingSensorEvents += (double)_sensorEventRate * (double)elapsedTime / 1000.0;
+      while (_pendingSensorEvents >= 1.0) {
+        _pendingSensorEvents -= 1.0;
+        if (_sensors.empty()) continue;
+        int32_t id = BaseLib::HelperFunctions::getRandomNumber(1, (int32_t)_sensors.size());
+        triggerSensor(id);
+        packets.push_back(std::make_shared<PhilipsHuePacket>(PhilipsHuePacket::Category::sensor, getAddress(PhilipsHuePacket::Category::sensor, id), 0, 1, copyJson(_sensors.at(id)), time));
+      }
+    }
+
+    for (auto &packet : packets) {
+      raisePacketReceived(packet);
+      _packetsRaised++;
+    }
+    if (!packets.empty()) raiseBatchEnd();
+    _lastPacketReceived = time;
+    _tickTimes.record(BaseLib::HelperFunctions::getTimeMicroseconds() - startTime);
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return BaseLib::HelperFunctions::getTime() + _tickInterval;
+}
+
+std::set<std::shared_ptr<PhilipsHuePacket>> SimulatedHueBridge::getPeerInfo() {
+  std::set<std::shared_ptr<PhilipsHuePacket>> peers;
+  try {
+    std::lock_guard<std::mutex> stateGuard(_stateMutex);
+    int64_t time = BaseLib::HelperFunctions::getTime();
+    for (auto &light : _lights) {
+      peers.emplace(std::make_shared<PhilipsHuePacket>(PhilipsHuePacket::Category::light, getAddress(PhilipsHuePacket::Category::light, light.first), 0, 1, copyJson(light.second), time));
+    }
+    for (auto &sensor : _sensors) {
+      peers.emplace(std::make_shared<PhilipsHuePacket>(PhilipsHuePacket::Category::sensor, getAddress(PhilipsHuePacket::Category::sensor, sensor.first), 0, 1, copyJson(sensor.second), time));
+    }
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return peers;
+}
+
+std::set<std::shared_ptr<PhilipsHuePacket>> SimulatedHueBridge::getGroupInfo() {
+  std::set<std::shared_ptr<PhilipsHuePacket>> groups;
+  try {
+    std::lock_guard<std::mutex> stateGuard(_stateMutex);
+    int64_t time = BaseLib::HelperFunctions::getTime();
+    for (auto &group : _groups) {
+      groups.emplace(std::make_shared<PhilipsHuePacket>(PhilipsHuePacket::Category::group, getAddress(PhilipsHuePacket::Category::group, group.first), 0, 1, copyJson(group.second), time));
+    }
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return groups;
+}
+
+PVariable SimulatedHueBridge::getStatistics() {
+  auto statistics = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+  try {
+    size_t pendingCommands = 0;
+    {
+      std::lock_guard<std::mutex> commandsGuard(_commandsMutex);
+      pendingCommands = _pendingCommands.size();
+    }
+    size_t activeTransitions = 0;
+    {
+      std::lock_guard<std::mutex> stateGuard(_stateMutex);
+      activeTransitions = _transitions.size();
+    }
+    statistics->structValue->emplace("lights", std::make_shared<BaseLib::Variable>((int64_t)_lightCount));
+    statistics->structValue->emplace("groups", std::make_shared<BaseLib::Variable>((int64_t)_groupCount));
+    statistics->structValue->emplace("sensors", std::make_shared<BaseLib::Variable>((int64_t)_sensorCount));
+    statistics->structValue->emplace("commandQueueDepth", std::make_shared<BaseLib::Variable>((int64_t)pendingCommands));
+    statistics->structValue->emplace("activeTransitions", std::make_shared<BaseLib::Variable>((int64_t)activeTransitions));
+    statistics->structValue->emplace("sentCommands", std::make_shared<BaseLib::Variable>((int64_t)_sentCommands));
+    statistics->structValue->emplace("failedCommands", std::make_shared<BaseLib::Variable>((int64_t)_failedCommands));
+    statistics->structValue->emplace("externalChanges", std::make_shared<BaseLib::Variable>((int64_t)_externalChanges));
+    statistics->structValue->emplace("sensorEvents", std::make_shared<BaseLib::Variable>((int64_t)_sensorEvents));
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return statistics;
+}
+
+PVariable SimulatedHueBridge::getMetrics() {
+  auto metrics = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+  try {
+    metrics->structValue->emplace("commandRoundTripTime", _commandRoundTripTimes.toVariable());
+    metrics->structValue->emplace("tickTime", _tickTimes.toVariable());
+    metrics->structValue->emplace("commandErrors", std::make_shared<BaseLib::Variable>((int64_t)_failedCommands));
+    metrics->structValue->emplace("packetsRaised", std::make_shared<BaseLib::Variable>((int64_t)_packetsRaised));
+    metrics->structValue->emplace("lastPacketReceived", std::make_shared<BaseLib::Variable>((int64_t)_lastPacketReceived));
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return metrics;
+}
+
+}
@@ -0,0 +1,157 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+
+#ifndef SIMULATEDHUEBRIDGE_H
+#define SIMULATEDHUEBRIDGE_H
+
+#include "../PhilipsHuePacket.h"
+#include "../LatencyHistogram.h"
+#include "IPhilipsHueInterface.h"
+
+#include <map>
+#include <set>
+#include <unordered_map>
+
+namespace PhilipsHue
+{
+
+/**
+ * Simulates a hue bridge in memory for load tests (interface type "huebridge-sim"). The bridge has a configurable number of lights,
+ * groups and sensors, changes brightness and colors gradually during transitions, changes lights and triggers sensors at random
+ * and answers commands with a configurable latency and failure rate. No network is needed.
+ */
+class SimulatedHueBridge  : public IPhilipsHueInterface
+{
+    public:
+        SimulatedHueBridge(std::shared_ptr<BaseLib::Systems::PhysicalInterfaceSettings> settings);
+        ~SimulatedHueBridge() override;
+        void startListening() override;
+        void stopListening() override;
+        void sendPacket(std::shared_ptr<BaseLib::Systems::Packet> packet) override;
+        std::future<bool> queuePacket(std::shared_ptr<PhilipsHuePacket> packet, CommandPriority priority) override;
+        bool isOpen() override { return _simulationTask != -1; }
+        void searchLights() override {}
+        bool userCreated() override { return true; }
+        std::set<std::shared_ptr<PhilipsHuePacket>> getPeerInfo() override;
+        std::set<std::shared_ptr<PhilipsHuePacket>> getGroupInfo() override;
+        PVariable getStatistics() override;
+        PVariable getMetrics() override;
+    protected:
+        struct Transition {
+          std::map<std::string, double> start;
+          std::map<std::string, double> target;
+          int64_t startTime = 0;
+          int64_t duration = 0;
+        };
+
+        struct PendingCommand {
+          std::shared_ptr<PhilipsHuePacket> packet;
+          std::promise<bool> result;
+          int64_t enqueueTime = 0;
+        };
+
+        uint32_t _lightCount = 50;
+        uint32_t _groupCount = 10;
+        uint32_t _sensorCount = 10;
+        uint32_t _latency = 20; //Milliseconds
+        uint32_t _failureRate = 0; //Percent of the commands that fail
+        uint32_t _changeRate = 1; //External light changes per second
+        uint32_t _sensorEventRate = 1; //Sensor events per second
+        const int64_t _tickInterval = 100;
+
+        std::mutex _stateMutex;
+        std::map<int32_t, PVariable> _lights;
+        std::map<int32_t, PVariable> _groups;
+        std::map<int32_t, PVariable> _sensors;
+        std::unordered_map<int32_t, std::vector<int32_t>> _groupsOfLight;
+        std::unordered_map<int32_t, Transition> _transitions;
+        int64_t _lastTick = 0;
+        double _pendingChanges = 0;
+        double _pendingSensorEvents = 0;
+
+        std::mutex _commandsMutex;
+        std::multimap<int64_t, std::shared_ptr<PendingCommand>> _pendingCommands; //Indexed by the time the command is answered
+        std::atomic<int32_t> _simulationTask{-1};
+        std::atomic<int32_t> _commandTask{-1};
+
+        std::atomic<uint64_t> _sentCommands{0};
+        std::atomic<uint64_t> _failedCommands{0};
+        std::atomic<uint64_t> _externalChanges{0};
+        std::atomic<uint64_t> _sensorEvents{0};
+        std::atomic<uint64_t> _packetsRaised{0};
+        LatencyHistogram _commandRoundTripTimes;
+        LatencyHistogram _tickTimes;
+
+        void createState();
+        static PVariable copyJson(const PVariable& json);
+        int32_t getAddress(PhilipsHuePacket::Category category, int32_t id);
+        std::string getTimestamp();
+        void removeTask(std::atomic<int32_t>& task);
+
+        /**
+         * Scheduler task advancing transitions and creating random changes and sensor events.
+         */
+        int64_t simulate();
+
+        /**
+         * Scheduler task answering the commands whose latency elapsed.
+         */
+        int64_t processCommands();
+
+        /**
+         * Applies a command to the simulated state. Must be called with "_stateMutex" locked.
+         *
+         * @param[out] packets The packets to raise for the changed lights and groups.
+         * @return Returns "false" when the light or group doesn't exist.
+         */
+        bool applyCommand(std::shared_ptr<PhilipsHuePacket>& packet, std::vector<std::shared_ptr<PhilipsHuePacket>>& packets);
+
+        /**
+         * Sets the state of a light. Brightness and colors are changed gradually when "transitiontime" is set. Must be called with "_stateMutex" locked.
+         */
+        void setLightState(int32_t id, const PVariable& values, int64_t time);
+
+        /**
+         * Advances the running transitions. Must be called with "_stateMutex" locked.
+         *
+         * @param[out] changedLights The IDs of the lights that changed.
+         */
+        void advanceTransitions(int64_t time, std::set<int32_t>& changedLights);
+
+        /**
+         * Updates "all_on" and "any_on" of the groups of the given lights and adds the packets of the lights and groups to "packets".
+         * Must be called with "_stateMutex" locked.
+         */
+        void collectPackets(const std::set<int32_t>& changedLights, std::vector<std::shared_ptr<PhilipsHuePacket>>& packets);
+        void triggerSensor(int32_t id);
+};
+
+}
+#endif
@@ -0,0 +1,156 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+
+#include "Scheduler.h"
+#include "GD.h"
+
+namespace PhilipsHue {
+
+Scheduler::Scheduler(uint32_t threadCount) {
+  if (threadCount < 1) threadCount = 1;
+  _threads.resize(threadCount);
+  for (auto &thread : _threads) {
+    GD::bl->threadManager.start(thread, true, &Scheduler::worker, this);
+  }
+}
+
+Scheduler::~Scheduler() {
+  stop();
+}
+
+void Scheduler::stop() {
+  {
+    std::lock_guard<std::mutex> tasksGuard(_tasksMutex);
+    _stop = true;
+  }
+  _tasksConditionVariable.notify_all();
+  for (auto &thread : _threads) {
+    GD::bl->threadManager.join(thread);
+  }
+}
+
+int32_t Scheduler::add(Task task, int64_t time) {
+  std::lock_guard<std::mutex> tasksGuard(_tasksMutex);
+  int32_t id = _currentId++;
+  auto &taskInfo = _tasks[id];
+  taskInfo.task = std::move(task);
+  if (time > 0) {
+    taskInfo.time = time;
+    _timeline.emplace(time, id);
+    _tasksConditionVariable.notify_one();
+  }
+  return id;
+}
+
+void Scheduler::wake(int32_t id) {
+  std::lock_guard<std::mutex> tasksGuard(_tasksMutex);
+  auto taskIterator = _tasks.find(id);
+  if (taskIterator == _tasks.end() || taskIterator->second.removed) return;
+  auto &taskInfo = taskIterator->second;
+  if (taskInfo.running) {
+    taskInfo.wakeRequested = true;
+    return;
+  }
+
+  if (taskInfo.time > 0) _timeline.erase(std::make_pair(taskInfo.time, id));
+  taskInfo.time = BaseLib::HelperFunctions::getTime();
+  _timeline.emplace(taskInfo.time, id);
+  _tasksConditionVariable.notify_one();
+}
+
+void Scheduler::remove(int32_t id) {
+  std::unique_lock<std::mutex> tasksGuard(_tasksMutex);
+  auto taskIterator = _tasks.find(id);
+  if (taskIterator == _tasks.end()) return;
+  auto &taskInfo = taskIterator->second;
+  taskInfo.removed = true;
+  if (taskInfo.time > 0) _timeline.erase(std::make_pair(taskInfo.time, id));
+  taskInfo.time = 0;
+  _taskFinishedConditionVariable.wait(tasksGuard, [&] { return !taskInfo.running; });
+  _tasks.erase(id);
+}
+
+void Scheduler::worker() {
+  std::unique_lock<std::mutex> tasksGuard(_tasksMutex);
+  while (!_stop) {
+    try {
+      if (_timeline.empty()) {
+        _tasksConditionVariable.wait(tasksGuard);
+        continue;
+      }
+
+      auto nextTask = _timeline.begin();
+      int64_t time = BaseLib::HelperFunctions::getTime();
+      if (nextTask->first > time) {
+        _tasksConditionVariable.wait_for(tasksGuard, std::chrono::milliseconds(nextTask->first - time));
+        continue;
+      }
+
+      int32_t id = nextTask->second;
+      _timeline.erase(nextTask);
+      auto taskIterator = _tasks.find(id);
+      if (taskIterator == _tasks.end()) continue;
+      //References to elements of an unordered_map stay valid until the element is erased. remove() only erases tasks that are not running.
+      auto &taskInfo = taskIterator->second;
+      taskInfo.time = 0;
+      taskInfo.running = true;
+      taskInfo.wakeRequested = false;
+      tasksGuard.unlock();
+
+      int64_t nextTime = 0;
+      try {
+        nextTime = taskInfo.task();
+      }
+      catch (const std::exception &ex) {
+        GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+        nextTime = BaseLib::HelperFunctions::getTime() + 1000;
+      }
+
+      tasksGuard.lock();
+      taskInfo.running = false;
+      if (taskInfo.removed) {
+        _taskFinishedConditionVariable.notify_all();
+        continue;
+      }
+      if (taskInfo.wakeRequested) nextTime = BaseLib::HelperFunctions::getTime();
+      if (nextTime > 0) {
+        taskInfo.time = nextTime;
+        _timeline.emplace(nextTime, id);
+        _tasksConditionVariable.notify_one();
+      }
+    }
+    catch (const std::exception &ex) {
+      if (!tasksGuard.owns_lock()) tasksGuard.lock();
+      GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+  }
+}
+
+}
@@ -0,0 +1,104 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace PhilipsHue {
+
+/**
+ * Runs the periodic work of all bridges (polling, sending commands, ...) on a fixed number of threads, so the number of threads doesn't grow with the number of bridges.
+ *
+ * A task never runs on more than one thread at the same time.
+ */
+class Scheduler {
+ public:
+  /**
+   * Returns the time (in milliseconds) the task wants to run again. When the returned time is 0 or less, the task only runs again when it is woken up.
+   */
+  typedef std::function<int64_t()> Task;
+
+  explicit Scheduler(uint32_t threadCount);
+  ~Scheduler();
+  void stop();
+
+  size_t threadCount() { return _threads.size(); }
+
+  /**
+   * Adds a task.
+   *
+   * @param task The task to run.
+   * @param time The time to run the task first. When 0 or less, the task only runs after it was woken up.
+   * @return The ID of the task.
+   */
+  int32_t add(Task task, int64_t time);
+
+  /**
+   * Runs a task as soon as possible. When the task is running, it runs again right afterwards.
+   */
+  void wake(int32_t id);
+
+  /**
+   * Removes a task. Blocks until the task finished running. Must not be called from within the task.
+   */
+  void remove(int32_t id);
+ private:
+  struct TaskInfo {
+    Task task;
+    int64_t time = 0; //Time in "_timeline" or 0 when not scheduled
+    bool running = false;
+    bool wakeRequested = false;
+    bool removed = false;
+  };
+
+  std::atomic_bool _stop{false};
+  std::mutex _tasksMutex;
+  std::condition_variable _tasksConditionVariable;
+  std::condition_variable _taskFinishedConditionVariable;
+  int32_t _currentId = 0;
+  std::unordered_map<int32_t, TaskInfo> _tasks;
+  std::set<std::pair<int64_t, int32_t>> _timeline;
+  std::vector<std::thread> _threads;
+
+  void worker();
+};
+
+}
+
+#endif
@@ -0,0 +1,118 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+
+
+#include "ValueConverter.h"
+
+namespace PhilipsHue {
+
+ValueConverter::Type ValueConverter::getType(const BaseLib::DeviceDescription::PParameter &parameter) {
+  if (!parameter || !parameter->logical || parameter->casts.empty()) return Type::generic;
+  if (!std::dynamic_pointer_cast<BaseLib::DeviceDescription::ParameterCast::RpcBinary>(parameter->casts.back())) return Type::generic;
+
+  if (parameter->casts.size() == 2) {
+    if (parameter->logical->type == BaseLib::DeviceDescription::ILogical::Type::Enum::tString && std::dynamic_pointer_cast<BaseLib::DeviceDescription::ParameterCast::StringJsonArrayDecimal>(parameter->casts.front())) return Type::decimalArray;
+    return Type::generic;
+  }
+  if (parameter->casts.size() != 1) return Type::generic;
+
+  switch (parameter->logical->type) {
+    case BaseLib::DeviceDescription::ILogical::Type::Enum::tBoolean:
+      return Type::boolean;
+    case BaseLib::DeviceDescription::ILogical::Type::Enum::tInteger: {
+      auto logical = std::dynamic_pointer_cast<BaseLib::DeviceDescription::LogicalInteger>(parameter->logical);
+      //Special values are converted by the generic path.
+      if (!logical || !logical->specialValuesStringMap.empty() || !logical->specialValuesIntegerMap.empty()) return Type::generic;
+      return Type::integer;
+    }
+    case BaseLib::DeviceDescription::ILogical::Type::Enum::tFloat: {
+      auto logical = std::dynamic_pointer_cast<BaseLib::DeviceDescription::LogicalDecimal>(parameter->logical);
+      if (!logical || !logical->specialValuesStringMap.empty() || !logical->specialValuesFloatMap.empty()) return Type::generic;
+      return Type::decimal;
+    }
+    case BaseLib::DeviceDescription::ILogical::Type::Enum::tString:
+      return Type::string;
+    default:
+      return Type::generic;
+  }
+}
+
+BaseLib::PVariable ValueConverter::fromValue(Type type, const BaseLib::DeviceDescription::PParameter &parameter, const BaseLib::PVariable &value) {
+  switch (type) {
+    case Type::boolean:
+      if (value->type != BaseLib::VariableType::tBoolean) return BaseLib::PVariable();
+      return std::make_shared<BaseLib::Variable>(value->booleanValue);
+    case Type::integer: {
+      if (value->type != BaseLib::VariableType::tInteger) return BaseLib::PVariable();
+      auto logical = static_cast<BaseLib::DeviceDescription::LogicalInteger *>(parameter->logical.get());
+      if (value->integerValue < logical->minimumValue || value->integerValue > logical->maximumValue) return BaseLib::PVariable();
+      return std::make_shared<BaseLib::Variable>(value->integerValue);
+    }
+    case Type::decimal: {
+      if (value->type != BaseLib::VariableType::tFloat) return BaseLib::PVariable();
+      auto logical = static_cast<BaseLib::DeviceDescription::LogicalDecimal *>(parameter->logical.get());
+      if (value->floatValue < logical->minimumValue || value->floatValue > logical->maximumValue) return BaseLib::PVariable();
+      return std::make_shared<BaseLib::Variable>(value->floatValue);
+    }
+    case Type::string:
+      if (value->type != BaseLib::VariableType::tString) return BaseLib::PVariable();
+      return std::make_shared<BaseLib::Variable>(value->stringValue);
+    default:
+      return BaseLib::PVariable();
+  }
+}
+
+BaseLib::PVariable ValueConverter::fromJson(Type type, const BaseLib::DeviceDescription::PParameter &parameter, const BaseLib::PVariable &json) {
+  if (!json) return BaseLib::PVariable();
+  if (type != Type::decimalArray) return fromValue(type, parameter, json);
+
+  if (json->type != BaseLib::VariableType::tArray) return BaseLib::PVariable();
+  auto array = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tArray);
+  array->arrayValue->reserve(json->arrayValue->size());
+  for (auto &element : *json->arrayValue) {
+    //The cast converts all elements to decimals.
+    if (element->type == BaseLib::VariableType::tFloat) array->arrayValue->push_back(std::make_shared<BaseLib::Variable>(element->floatValue));
+    else if (element->type == BaseLib::VariableType::tInteger) array->arrayValue->push_back(std::make_shared<BaseLib::Variable>((double)element->integerValue));
+    else return BaseLib::PVariable();
+  }
+  return array;
+}
+
+BaseLib::PVariable ValueConverter::fromRpc(Type type, const BaseLib::DeviceDescription::PParameter &parameter, const BaseLib::PVariable &value) {
+  if (!value || type == Type::decimalArray) return BaseLib::PVariable();
+  return fromValue(type, parameter, value);
+}
+
+BaseLib::PVariable ValueConverter::toRpc(Type type, const BaseLib::PVariable &packetValue) {
+  if (!packetValue || type == Type::generic || type == Type::decimalArray) return BaseLib::PVariable();
+  return packetValue;
+}
+
+}
@@ -0,0 +1,84 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+
+
+#ifndef VALUECONVERTER_H_
+#define VALUECONVERTER_H_
+
+#include <homegear-base/BaseLib.h>
+
+namespace PhilipsHue {
+
+/**
+ * Converts values between the JSON of the bridge, the stored parameter data and RPC without the generic cast chain of BaseLib
+ * (encodeResponse, convertFromPacket and convertToPacket). Only the cast chains used by the Hue device descriptions are
+ * supported: "rpcBinary" for booleans, integers, decimals and strings and "stringJsonArrayDecimal" + "rpcBinary" for the XY
+ * arrays. For these the stored data is the RPC encoded packet value. All other parameters and all values the generic path
+ * might change (e. g. integers out of range) return nullptr, so the caller has to fall back to the generic conversion.
+ */
+class ValueConverter {
+ public:
+  enum class Type : uint8_t {
+    generic,
+    boolean,
+    integer,
+    decimal,
+    string,
+    decimalArray
+  };
+
+  /**
+   * Returns the conversion supported for a parameter.
+   */
+  static Type getType(const BaseLib::DeviceDescription::PParameter &parameter);
+
+  /**
+   * Returns the packet value for a value of the JSON of the bridge or nullptr when the generic conversion is needed. The
+   * returned variable is a new one.
+   */
+  static BaseLib::PVariable fromJson(Type type, const BaseLib::DeviceDescription::PParameter &parameter, const BaseLib::PVariable &json);
+
+  /**
+   * Returns the packet value for a value passed by RPC or nullptr when the generic conversion is needed.
+   */
+  static BaseLib::PVariable fromRpc(Type type, const BaseLib::DeviceDescription::PParameter &parameter, const BaseLib::PVariable &value);
+
+  /**
+   * Returns the RPC value for a packet value or nullptr when the generic conversion is needed. The RPC value of an XY array is
+   * a string formatted by its cast, so it is always converted by the generic path.
+   */
+  static BaseLib::PVariable toRpc(Type type, const BaseLib::PVariable &packetValue);
+ private:
+  static BaseLib::PVariable fromValue(Type type, const BaseLib::DeviceDescription::PParameter &parameter, const BaseLib::PVariable &value);
+};
+
+}
+
+#endif
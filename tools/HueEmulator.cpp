@@ -0,0 +1,924 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+
+/*
+ * Emulates the parts of the hue REST API (v1) used by the module, so the network code of HueBridge can be benchmarked end to end on
+ * localhost. Run one instance per emulated bridge and add a "huebridge" interface with host "127.0.0.1" and the port of the instance to
+ * "philipshue.conf". See "--help" for the options.
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace HueEmulator {
+
+std::atomic_bool stop{false};
+
+int64_t getTime() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int32_t getRandomNumber(int32_t min, int32_t max) {
+  thread_local std::mt19937 generator(std::random_device{}());
+  std::uniform_int_distribution<int32_t> distribution(min, max);
+  return distribution(generator);
+}
+
+std::string getTimestamp() {
+  std::time_t time = std::time(nullptr);
+  std::tm timeStruct{};
+  gmtime_r(&time, &timeStruct);
+  char buffer[32];
+  std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S", &timeStruct);
+  return std::string(buffer);
+}
+
+struct Options {
+  int32_t port = 8080;
+  int32_t lights = 50;
+  int32_t groups = 10;
+  int32_t sensors = 10;
+  int32_t latency = 0; //Milliseconds
+  int32_t jitter = 0; //Milliseconds
+  double lightRate = 10; //Commands per second, 0 means unlimited
+  double groupRate = 1; //Commands per second, 0 means unlimited
+  bool rejectOverLimit = false;
+  int32_t padding = 0; //Additional bytes per light
+  double changeRate = 0; //External light changes per second
+  double sensorEventRate = 0; //Sensor events per second
+  std::string script;
+  int32_t idleTimeout = 0; //Milliseconds, 0 means never
+  int32_t maxRequests = 0; //Requests per connection, 0 means unlimited
+  int32_t linkButtonAttempts = 0; //Number of user creations failing with "link button not pressed"
+  bool strictUsers = false;
+  std::vector<std::string> users;
+  int32_t statisticsInterval = 0; //Seconds
+};
+
+// {{{ Minimal JSON handling. Objects are kept as lists of members with their raw values, which is all the emulator needs.
+size_t skipSpace(const std::string &json, size_t position) {
+  while (position < json.size() && (json[position] == ' ' || json[position] == '\t' || json[position] == '\r' || json[position] == '\n')) position++;
+  return position;
+}
+
+/**
+ * Returns the position after the JSON value starting at "position" or std::string::npos when the value is invalid.
+ */
+size_t skipValue(const std::string &json, size_t position) {
+  if (position >= json.size()) return std::string::npos;
+  char c = json[position];
+  if (c == '"') {
+    for (size_t i = position + 1; i < json.size(); i++) {
+      if (json[i] == '\\') i++;
+      else if (json[i] == '"') return i + 1;
+    }
+    return std::string::npos;
+  } else if (c == '{' || c == '[') {
+    int32_t depth = 0;
+    bool inString = false;
+    for (size_t i = position; i < json.size(); i++) {
+      char d = json[i];
+      if (inString) {
+        if (d == '\\') i++;
+        else if (d == '"') inString = false;
+      } else if (d == '"') inString = true;
+      else if (d == '{' || d == '[') depth++;
+      else if ((d == '}' || d == ']') && --depth == 0) return i + 1;
+    }
+    return std::string::npos;
+  }
+  size_t end = json.find_first_of(",}] \t\r\n", position);
+  if (end == std::string::npos) end = json.size();
+  return end == position ? std::string::npos : end;
+}
+
+class JsonObject {
+ public:
+  std::vector<std::pair<std::string, std::string>> members;
+
+  bool parse(const std::string &json) {
+    members.clear();
+    size_t position = skipSpace(json, 0);
+    if (position >= json.size() || json[position] != '{') return false;
+    position = skipSpace(json, position + 1);
+    if (position < json.size() && json[position] == '}') return true;
+    while (position < json.size()) {
+      if (json[position] != '"') return false;
+      size_t keyEnd = skipValue(json, position);
+      if (keyEnd == std::string::npos) return false;
+      std::string key = json.substr(position + 1, keyEnd - position - 2);
+      position = skipSpace(json, keyEnd);
+      if (position >= json.size() || json[position] != ':') return false;
+      position = skipSpace(json, position + 1);
+      size_t valueEnd = skipValue(json, position);
+      if (valueEnd == std::string::npos) return false;
+      members.emplace_back(key, json.substr(position, valueEnd - position));
+      position = skipSpace(json, valueEnd);
+      if (position < json.size() && json[position] == ',') {
+        position = skipSpace(json, position + 1);
+        continue;
+      }
+      return position < json.size() && json[position] == '}';
+    }
+    return false;
+  }
+
+  std::string get(const std::string &key) const {
+    for (auto &member : members) {
+      if (member.first == key) return member.second;
+    }
+    return "";
+  }
+
+  void set(const std::string &key, const std::string &value) {
+    for (auto &member : members) {
+      if (member.first == key) {
+        member.second = value;
+        return;
+      }
+    }
+    members.emplace_back(key, value);
+  }
+
+  std::string toString() const {
+    std::string json = "{";
+    for (auto &member : members) {
+      if (json.size() > 1) json.push_back(',');
+      json.append("\"" + member.first + "\":" + member.second);
+    }
+    json.push_back('}');
+    return json;
+  }
+};
+
+std::string quote(const std::string &value) {
+  return "\"" + value + "\"";
+}
+
+std::string error(int32_t type, const std::string &address, const std::string &description) {
+  return "{\"error\":{\"type\":" + std::to_string(type) + ",\"address\":" + quote(address) + ",\"description\":" + quote(description) + "}}";
+}
+// }}}
+
+class TokenBucket {
+ public:
+  explicit TokenBucket(double rate) : _rate(rate), _tokens(std::max(1.0, rate)) {}
+
+  /**
+   * Takes a token.
+   *
+   * @param reject When "true", no token is taken when none is available.
+   * @return Returns the time in milliseconds to wait until the token is available or -1 when "reject" is set and no token is available.
+   */
+  int64_t take(bool reject) {
+    if (_rate <= 0) return 0;
+    std::lock_guard<std::mutex> bucketGuard(_mutex);
+    int64_t time = getTime();
+    if (_lastRefill == 0) _lastRefill = time;
+    _tokens = std::min(std::max(1.0, _rate), _tokens + (double)(time - _lastRefill) * _rate / 1000.0);
+    _lastRefill = time;
+    if (_tokens >= 1.0) {
+      _tokens -= 1.0;
+      return 0;
+    }
+    if (reject) return -1;
+    //The token is taken in advance, so waiting requests are served in order.
+    _tokens -= 1.0;
+    return (int64_t)std::ceil(-_tokens * 1000.0 / _rate);
+  }
+ private:
+  std::mutex _mutex;
+  double _rate = 0;
+  double _tokens = 0;
+  int64_t _lastRefill = 0;
+};
+
+struct Statistics {
+  std::atomic<int64_t> connections{0};
+  std::atomic<int64_t> closedIdleConnections{0};
+  std::atomic<int64_t> requests{0};
+  std::atomic<int64_t> commands{0};
+  std::atomic<int64_t> polls{0};
+  std::atomic<int64_t> delayedCommands{0};
+  std::atomic<int64_t> rejectedCommands{0};
+  std::atomic<int64_t> externalChanges{0};
+  std::atomic<int64_t> sensorEvents{0};
+  std::atomic<int64_t> bytesReceived{0};
+  std::atomic<int64_t> bytesSent{0};
+
+  std::string toString() {
+    return "{\"connections\":" + std::to_string(connections) + ",\"closedIdleConnections\":" + std::to_string(closedIdleConnections) + ",\"requests\":" + std::to_string(requests) + ",\"commands\":" + std::to_string(commands) + ",\"polls\":" + std::to_string(polls) + ",\"delayedCommands\":" + std::to_string(delayedCommands) + ",\"rejectedCommands\":" + std::to_string(rejectedCommands) + ",\"externalChanges\":" + std::to_string(externalChanges) + ",\"sensorEvents\":" + std::to_string(sensorEvents) + ",\"bytesReceived\":" + std::to_string(bytesReceived) + ",\"bytesSent\":" + std::to_string(bytesSent) + "}";
+  }
+
+  void reset() {
+    connections = 0;
+    closedIdleConnections = 0;
+    requests = 0;
+    commands = 0;
+    polls = 0;
+    delayedCommands = 0;
+    rejectedCommands = 0;
+    externalChanges = 0;
+    sensorEvents = 0;
+    bytesReceived = 0;
+    bytesSent = 0;
+  }
+};
+
+class Bridge {
+ public:
+  Bridge(const Options &options, Statistics &statistics) : _options(options), _statistics(statistics), _lightBucket(options.lightRate), _groupBucket(options.groupRate) {
+    for (int32_t id = 1; id <= options.lights; id++) {
+      Light &light = _lights[id];
+      light.name = "Emulated light " + std::to_string(id);
+      light.state.parse(R"({"on":false,"bri":254,"hue":8418,"sat":140,"effect":"none","xy":[0.4573,0.41],"ct":366,"alert":"none","colormode":"ct","mode":"homeautomation","reachable":true})");
+      char uniqueId[32];
+      snprintf(uniqueId, sizeof(uniqueId), "00:17:88:01:00:%02x:%02x:%02x-0b", (id >> 16) & 0xFF, (id >> 8) & 0xFF, id & 0xFF);
+      light.uniqueId = uniqueId;
+    }
+    for (int32_t id = 1; id <= options.groups; id++) {
+      Group &group = _groups[id];
+      group.name = "Emulated group " + std::to_string(id);
+      group.action.parse(R"({"on":false,"bri":254,"hue":8418,"sat":140,"effect":"none","xy":[0.4573,0.41],"ct":366,"alert":"none","colormode":"ct"})");
+    }
+    if (options.groups > 0) {
+      for (auto &light : _lights) {
+        _groups.at(((light.first - 1) % options.groups) + 1).lights.push_back(light.first);
+      }
+    }
+    for (int32_t id = 1; id <= options.sensors; id++) {
+      Sensor &sensor = _sensors[id];
+      sensor.name = "Emulated sensor " + std::to_string(id);
+      sensor.isSwitch = (id & 1) == 1;
+      if (sensor.isSwitch) sensor.state.parse(R"({"buttonevent":1002})");
+      else sensor.state.parse(R"({"presence":false})");
+      sensor.state.set("lastupdated", quote(getTimestamp()));
+    }
+    _padding = quote(std::string(options.padding, 'x'));
+  }
+
+  /**
+   * Handles a request.
+   *
+   * @param[out] body The JSON response.
+   * @return The HTTP status code.
+   */
+  int32_t handle(const std::string &method, const std::string &path, const std::string &requestBody, std::string &body) {
+    if (path == "/emulator/stats" && method == "GET") {
+      body = _statistics.toString();
+      return 200;
+    } else if (path == "/emulator/reset" && method == "POST") {
+      _statistics.reset();
+      body = "[{\"success\":\"/emulator/reset\"}]";
+      return 200;
+    }
+
+    if (path.compare(0, 4, "/api") != 0) {
+      body = "[" + error(4, path, "method, " + method + ", not available for resource, " + path) + "]";
+      return 404;
+    }
+    if (path == "/api" || path == "/api/") {
+      if (method != "POST") {
+        body = "[" + error(4, "/", "method, " + method + ", not available for resource, /") + "]";
+        return 200;
+      }
+      body = createUser();
+      return 200;
+    }
+
+    std::vector<std::string> elements;
+    std::stringstream stream(path.substr(5));
+    std::string element;
+    while (std::getline(stream, element, '/')) {
+      if (!element.empty()) elements.push_back(element);
+    }
+    if (elements.empty() || !userKnown(elements.front())) {
+      body = "[" + error(1, "/", "unauthorized user") + "]";
+      return 200;
+    }
+    std::string resource = path.substr(5 + elements.front().size());
+
+    if (method == "GET") {
+      _statistics.polls++;
+      std::lock_guard<std::mutex> stateGuard(_stateMutex);
+      if (elements.size() == 1) body = "{\"lights\":" + getLights() + ",\"groups\":" + getGroups() + ",\"sensors\":" + getSensors() + ",\"config\":" + getConfig() + "}";
+      else if (elements.size() == 2 && elements.at(1) == "lights") body = getLights();
+      else if (elements.size() == 2 && elements.at(1) == "groups") body = getGroups();
+      else if (elements.size() == 2 && elements.at(1) == "sensors") body = getSensors();
+      else if (elements.size() == 2 && elements.at(1) == "config") body = getConfig();
+      else if (elements.size() == 3 && elements.at(1) == "lights" && elements.at(2) == "new") body = "{\"lastscan\":" + (getTime() < _scanEnd ? quote("active") : quote(_lastScan)) + "}";
+      else if (elements.size() == 3 && elements.at(1) == "lights" && _lights.find(std::atoi(elements.at(2).c_str())) != _lights.end()) body = getLight(std::atoi(elements.at(2).c_str()));
+      else if (elements.size() == 3 && elements.at(1) == "groups" && _groups.find(std::atoi(elements.at(2).c_str())) != _groups.end()) body = getGroup(std::atoi(elements.at(2).c_str()));
+      else body = "[" + error(3, resource, "resource, " + resource + ", not available") + "]";
+      return 200;
+    } else if (method == "POST" && elements.size() == 2 && elements.at(1) == "lights") {
+      std::lock_guard<std::mutex> stateGuard(_stateMutex);
+      _scanEnd = getTime() + 40000;
+      _lastScan = getTimestamp();
+      body = "[{\"success\":{\"/lights\":\"Searching for new devices\"}}]";
+      return 200;
+    } else if (method == "PUT" && elements.size() == 4 && ((elements.at(1) == "lights" && elements.at(3) == "state") || (elements.at(1) == "groups" && elements.at(3) == "action"))) {
+      _statistics.commands++;
+      int64_t waitTime = (elements.at(1) == "lights" ? _lightBucket : _groupBucket).take(_options.rejectOverLimit);
+      if (waitTime < 0) {
+        //What the bridge returns when its command buffer overflows.
+        _statistics.rejectedCommands++;
+        body = "[" + error(901, resource, "Internal error, 503") + "]";
+        return 200;
+      } else if (waitTime > 0) {
+        _statistics.delayedCommands++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(waitTime));
+      }
+      body = put(resource, requestBody);
+      return 200;
+    }
+    body = "[" + error(4, resource, "method, " + method + ", not available for resource, " + resource) + "]";
+    return 200;
+  }
+
+  /**
+   * Sets the state of a light or sensor or the action of a group.
+   *
+   * @param resource E. g. "/lights/1/state".
+   * @return The JSON response.
+   */
+  std::string put(const std::string &resource, const std::string &requestBody) {
+    JsonObject values;
+    if (!values.parse(requestBody)) return "[" + error(2, resource, "body contains invalid json") + "]";
+
+    std::vector<std::string> elements;
+    std::stringstream stream(resource);
+    std::string element;
+    while (std::getline(stream, element, '/')) {
+      if (!element.empty()) elements.push_back(element);
+    }
+    if (elements.size() != 3) return "[" + error(3, resource, "resource, " + resource + ", not available") + "]";
+    int32_t id = std::atoi(elements.at(1).c_str());
+
+    std::lock_guard<std::mutex> stateGuard(_stateMutex);
+    std::string response = "[";
+    if (elements.at(0) == "lights") {
+      auto lightIterator = _lights.find(id);
+      if (lightIterator == _lights.end()) return "[" + error(3, resource, "resource, /lights/" + elements.at(1) + ", not available") + "]";
+      for (auto &value : values.members) {
+        if (response.size() > 1) response.push_back(',');
+        response.append(setLightValue(lightIterator->second, values, value.first, value.second, resource));
+      }
+    } else if (elements.at(0) == "groups") {
+      std::vector<int32_t> members;
+      JsonObject *action = nullptr;
+      if (id == 0) {
+        for (auto &light : _lights) {
+          members.push_back(light.first);
+        }
+      } else {
+        auto groupIterator = _groups.find(id);
+        if (groupIterator == _groups.end()) return "[" + error(3, resource, "resource, /groups/" + elements.at(1) + ", not available") + "]";
+        members = groupIterator->second.lights;
+        action = &groupIterator->second.action;
+      }
+      for (auto &value : values.members) {
+        if (response.size() > 1) response.push_back(',');
+        if (value.first == "transitiontime") {
+          response.append("{\"success\":{" + quote(resource + "/" + value.first) + ":" + value.second + "}}");
+          continue;
+        }
+        for (auto member : members) {
+          setLightValue(_lights.at(member), values, value.first, value.second, resource);
+        }
+        if (action) action->set(value.first, value.second);
+        response.append("{\"success\":{" + quote(resource + "/" + value.first) + ":" + value.second + "}}");
+      }
+    } else if (elements.at(0) == "sensors") {
+      auto sensorIterator = _sensors.find(id);
+      if (sensorIterator == _sensors.end()) return "[" + error(3, resource, "resource, /sensors/" + elements.at(1) + ", not available") + "]";
+      for (auto &value : values.members) {
+        if (response.size() > 1) response.push_back(',');
+        sensorIterator->second.state.set(value.first, value.second);
+        response.append("{\"success\":{" + quote(resource + "/" + value.first) + ":" + value.second + "}}");
+      }
+      sensorIterator->second.state.set("lastupdated", quote(getTimestamp()));
+    } else return "[" + error(3, resource, "resource, " + resource + ", not available") + "]";
+    response.push_back(']');
+    return response;
+  }
+
+  /**
+   * Changes a random light like the hue app or a light switch would.
+   */
+  void changeRandomLight() {
+    if (_lights.empty()) return;
+    int32_t id = getRandomNumber(1, (int32_t)_lights.size());
+    if (getRandomNumber(0, 1) == 0) {
+      std::lock_guard<std::mutex> stateGuard(_stateMutex);
+      auto &state = _lights.at(id).state;
+      state.set("on", state.get("on") == "true" ? "false" : "true");
+    } else put("/lights/" + std::to_string(id) + "/state", "{\"on\":true,\"bri\":" + std::to_string(getRandomNumber(1, 254)) + "}");
+    _statistics.externalChanges++;
+  }
+
+  void triggerRandomSensor() {
+    if (_sensors.empty()) return;
+    std::lock_guard<std::mutex> stateGuard(_stateMutex);
+    auto &sensor = _sensors.at(getRandomNumber(1, (int32_t)_sensors.size()));
+    if (sensor.isSwitch) sensor.state.set("buttonevent", std::to_string(getRandomNumber(1, 4) * 1000 + 2));
+    else sensor.state.set("presence", sensor.state.get("presence") == "true" ? "false" : "true");
+    sensor.state.set("lastupdated", quote(getTimestamp()));
+    _statistics.sensorEvents++;
+  }
+ private:
+  struct Light {
+    std::string name;
+    std::string uniqueId;
+    JsonObject state;
+  };
+
+  struct Group {
+    std::string name;
+    std::vector<int32_t> lights;
+    JsonObject action;
+  };
+
+  struct Sensor {
+    std::string name;
+    bool isSwitch = false;
+    JsonObject state;
+  };
+
+  const Options &_options;
+  Statistics &_statistics;
+  TokenBucket _lightBucket;
+  TokenBucket _groupBucket;
+  std::string _padding;
+
+  std::mutex _usersMutex;
+  std::vector<std::string> _createdUsers;
+  int32_t _userCreationAttempts = 0;
+
+  std::mutex _stateMutex;
+  std::map<int32_t, Light> _lights;
+  std::map<int32_t, Group> _groups;
+  std::map<int32_t, Sensor> _sensors;
+  int64_t _scanEnd = 0;
+  std::string _lastScan = "none";
+
+  std::string createUser() {
+    std::lock_guard<std::mutex> usersGuard(_usersMutex);
+    if (_userCreationAttempts++ < _options.linkButtonAttempts) return "[" + error(101, "", "link button not pressed") + "]";
+    std::string username = "emulator";
+    for (int32_t i = 0; i < 32; i++) {
+      username.push_back("0123456789abcdef"[getRandomNumber(0, 15)]);
+    }
+    _createdUsers.push_back(username);
+    return "[{\"success\":{\"username\":" + quote(username) + "}}]";
+  }
+
+  bool userKnown(const std::string &username) {
+    if (!_options.strictUsers) return true;
+    if (std::find(_options.users.begin(), _options.users.end(), username) != _options.users.end()) return true;
+    std::lock_guard<std::mutex> usersGuard(_usersMutex);
+    return std::find(_createdUsers.begin(), _createdUsers.end(), username) != _createdUsers.end();
+  }
+
+  /**
+   * Sets one value of a light. Must be called with "_stateMutex" locked.
+   *
+   * @return The JSON response for the value.
+   */
+  std::string setLightValue(Light &light, const JsonObject &values, const std::string &key, const std::string &value, const std::string &resource) {
+    static const std::vector<std::string> stateKeys{"on", "bri", "hue", "sat", "xy", "ct", "alert", "effect"};
+    if (key == "transitiontime") return "{\"success\":{" + quote(resource + "/" + key) + ":" + value + "}}";
+    if (std::find(stateKeys.begin(), stateKeys.end(), key) == stateKeys.end()) return error(6, resource + "/" + key, "parameter, " + key + ", not available");
+    if (key != "on" && light.state.get("on") == "false" && values.get("on") != "true") return error(201, resource + "/" + key, "parameter, " + key + ", is not modifiable. Device is set to off.");
+    light.state.set(key, value);
+    if (key == "hue" || key == "sat") light.state.set("colormode", quote("hs"));
+    else if (key == "xy" || key == "ct") light.state.set("colormode", quote(key));
+    return "{\"success\":{" + quote(resource + "/" + key) + ":" + value + "}}";
+  }
+
+  std::string getLight(int32_t id) {
+    auto &light = _lights.at(id);
+    std::string json = "{\"state\":" + light.state.toString() + ",\"type\":\"Extended color light\",\"name\":" + quote(light.name) + ",\"modelid\":\"LCT015\",\"manufacturername\":\"Philips\",\"uniqueid\":" + quote(light.uniqueId) + ",\"swversion\":\"1.46.13_r26312\"";
+    if (_options.padding > 0) json.append(",\"padding\":" + _padding);
+    json.push_back('}');
+    return json;
+  }
+
+  std::string getLights() {
+    std::string json = "{";
+    for (auto &light : _lights) {
+      if (json.size() > 1) json.push_back(',');
+      json.append(quote(std::to_string(light.first)) + ":" + getLight(light.first));
+    }
+    json.push_back('}');
+    return json;
+  }
+
+  std::string getGroup(int32_t id) {
+    auto &group = _groups.at(id);
+    bool allOn = !group.lights.empty();
+    bool anyOn = false;
+    std::string lights;
+    for (auto lightId : group.lights) {
+      bool on = _lights.at(lightId).state.get("on") == "true";
+      allOn = allOn && on;
+      anyOn = anyOn || on;
+      if (!lights.empty()) lights.push_back(',');
+      lights.append(quote(std::to_string(lightId)));
+    }
+    return "{\"name\":" + quote(group.name) + ",\"lights\":[" + lights + "],\"type\":\"Room\",\"state\":{\"all_on\":" + (allOn ? "true" : "false") + ",\"any_on\":" + (anyOn ? "true" : "false") + "},\"action\":" + group.action.toString() + "}";
+  }
+
+  std::string getGroups() {
+    std::string json = "{";
+    for (auto &group : _groups) {
+      if (json.size() > 1) json.push_back(',');
+      json.append(quote(std::to_string(group.first)) + ":" + getGroup(group.first));
+    }
+    json.push_back('}');
+    return json;
+  }
+
+  std::string getSensors() {
+    std::string json = "{";
+    for (auto &sensor : _sensors) {
+      if (json.size() > 1) json.push_back(',');
+      json.append(quote(std::to_string(sensor.first)) + ":{\"state\":" + sensor.second.state.toString() + ",\"config\":{\"on\":true,\"battery\":100,\"reachable\":true},\"name\":" + quote(sensor.second.name) + ",\"type\":" + (sensor.second.isSwitch ? "\"ZLLSwitch\",\"modelid\":\"RWL021\"" : "\"ZLLPresence\",\"modelid\":\"SML001\"") + ",\"manufacturername\":\"Philips\",\"swversion\":\"6.1.1.28573\"}");
+    }
+    json.push_back('}');
+    return json;
+  }
+
+  std::string getConfig() {
+    return "{\"name\":\"Hue emulator\",\"modelid\":\"BSB002\",\"bridgeid\":\"001788FFFE000000\",\"apiversion\":\"1.24.0\",\"swversion\":\"1924020040\",\"linkbutton\":false}";
+  }
+};
+
+/**
+ * Replays state changes from a file. Each line has the format "<milliseconds> <resource> <json>", e. g. "1500 /lights/3/state {"on":false}".
+ * The script restarts after the last line.
+ */
+class Script {
+ public:
+  bool load(const std::string &filename) {
+    std::ifstream file(filename);
+    if (!file) return false;
+    std::string line;
+    while (std::getline(file, line)) {
+      if (line.empty() || line.front() == '#') continue;
+      std::stringstream stream(line);
+      Entry entry;
+      if (!(stream >> entry.time >> entry.resource)) continue;
+      std::getline(stream, entry.json);
+      _entries.push_back(entry);
+    }
+    std::stable_sort(_entries.begin(), _entries.end(), [](const Entry &a, const Entry &b) { return a.time < b.time; });
+    return !_entries.empty();
+  }
+
+  void run(Bridge &bridge, Statistics &statistics) {
+    if (_entries.empty()) return;
+    int64_t time = getTime();
+    if (_cycleStart == 0) _cycleStart = time;
+    while (_index < _entries.size() && time - _cycleStart >= _entries.at(_index).time) {
+      bridge.put(_entries.at(_index).resource, _entries.at(_index).json);
+      statistics.externalChanges++;
+      _index++;
+    }
+    if (_index == _entries.size()) {
+      _index = 0;
+      _cycleStart += std::max((int64_t)1, _entries.back().time);
+    }
+  }
+ private:
+  struct Entry {
+    int64_t time = 0;
+    std::string resource;
+    std::string json;
+  };
+
+  std::vector<Entry> _entries;
+  size_t _index = 0;
+  int64_t _cycleStart = 0;
+};
+
+class Server {
+ public:
+  Server(const Options &options, Bridge &bridge, Statistics &statistics) : _options(options), _bridge(bridge), _statistics(statistics) {}
+
+  bool start() {
+    _socket = socket(AF_INET, SOCK_STREAM, 0);
+    if (_socket == -1) return false;
+    int32_t reuse = 1;
+    setsockopt(_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons((uint16_t)_options.port);
+    if (bind(_socket, (sockaddr *)&address, sizeof(address)) == -1 || listen(_socket, 128) == -1) {
+      close(_socket);
+      _socket = -1;
+      return false;
+    }
+    return true;
+  }
+
+  void run() {
+    while (!stop) {
+      pollfd descriptor{_socket, POLLIN, 0};
+      if (poll(&descriptor, 1, 100) <= 0) continue;
+      int32_t clientSocket = accept(_socket, nullptr, nullptr);
+      if (clientSocket == -1) continue;
+      int32_t noDelay = 1;
+      setsockopt(clientSocket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+      _statistics.connections++;
+      _activeConnections++;
+      std::thread(&Server::serve, this, clientSocket).detach();
+    }
+    while (_activeConnections > 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    close(_socket);
+  }
+ private:
+  const Options &_options;
+  Bridge &_bridge;
+  Statistics &_statistics;
+  int32_t _socket = -1;
+  std::atomic<int32_t> _activeConnections{0};
+
+  /**
+   * Reads from the socket until "buffer" contains at least "size" bytes.
+   *
+   * @param idle When "true", the connection is closed after the idle timeout like the bridge does with unused keep-alive connections.
+   */
+  bool read(int32_t clientSocket, std::string &buffer, size_t size, bool idle) {
+    int64_t startTime = getTime();
+    char data[4096];
+    while (buffer.size() < size && !stop) {
+      pollfd descriptor{clientSocket, POLLIN, 0};
+      int32_t result = poll(&descriptor, 1, 100);
+      if (result < 0) return false;
+      if (result == 0) {
+        if (idle && buffer.empty() && _options.idleTimeout > 0 && getTime() - startTime >= _options.idleTimeout) {
+          _statistics.closedIdleConnections++;
+          return false;
+        }
+        continue;
+      }
+      ssize_t bytesRead = recv(clientSocket, data, sizeof(data), 0);
+      if (bytesRead <= 0) return false;
+      buffer.append(data, (size_t)bytesRead);
+      _statistics.bytesReceived += bytesRead;
+    }
+    return buffer.size() >= size;
+  }
+
+  void serve(int32_t clientSocket) {
+    std::string buffer;
+    int32_t requests = 0;
+    while (!stop) {
+      size_t headerEnd = std::string::npos;
+      while ((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+        if (!read(clientSocket, buffer, buffer.size() + 1, true)) {
+          close(clientSocket);
+          _activeConnections--;
+          return;
+        }
+      }
+
+      std::stringstream headerStream(buffer.substr(0, headerEnd));
+      std::string method;
+      std::string path;
+      std::string line;
+      headerStream >> method >> path;
+      std::getline(headerStream, line);
+      size_t contentLength = 0;
+      bool keepAlive = true;
+      while (std::getline(headerStream, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        std::string name = line.substr(0, colon);
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        std::string value = line.substr(colon + 1);
+        value.erase(0, value.find_first_not_of(' '));
+        std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+        if (name == "content-length") contentLength = (size_t)std::strtoul(value.c_str(), nullptr, 10);
+        else if (name == "connection") keepAlive = value != "close";
+      }
+      if (!read(clientSocket, buffer, headerEnd + 4 + contentLength, false)) break;
+      std::string body = buffer.substr(headerEnd + 4, contentLength);
+      buffer.erase(0, headerEnd + 4 + contentLength);
+      _statistics.requests++;
+      requests++;
+
+      if (_options.latency > 0 || _options.jitter > 0) {
+        int32_t latency = std::max(0, _options.latency + getRandomNumber(-_options.jitter, _options.jitter));
+        std::this_thread::sleep_for(std::chrono::milliseconds(latency));
+      }
+
+      std::string responseBody;
+      int32_t status = _bridge.handle(method, path, body, responseBody);
+      if (_options.maxRequests > 0 && requests >= _options.maxRequests) keepAlive = false;
+      std::string response = "HTTP/1.1 " + std::to_string(status) + (status == 200 ? " OK" : " Not Found") + "\r\nContent-Type: application/json\r\nContent-Length: " + std::to_string(responseBody.size()) + "\r\nConnection: " + (keepAlive ? "Keep-Alive" : "close") + "\r\n\r\n" + responseBody;
+      size_t bytesSent = 0;
+      while (bytesSent < response.size()) {
+        ssize_t result = send(clientSocket, response.data() + bytesSent, response.size() - bytesSent, MSG_NOSIGNAL);
+        if (result <= 0) break;
+        bytesSent += (size_t)result;
+      }
+      _statistics.bytesSent += (int64_t)bytesSent;
+      if (bytesSent < response.size() || !keepAlive) break;
+    }
+    close(clientSocket);
+    _activeConnections--;
+  }
+};
+
+void printHelp() {
+  std::cout << "Usage: hue-emulator [OPTIONS]" << std::endl << std::endl;
+  std::cout << "Emulates the hue REST API on 127.0.0.1." << std::endl << std::endl;
+  std::cout << "Options:" << std::endl;
+  std::cout << "  --port PORT                 Port to listen on. Default: 8080" << std::endl;
+  std::cout << "  --lights COUNT              Number of lights. Default: 50" << std::endl;
+  std::cout << "  --groups COUNT              Number of groups. Lights are distributed evenly. Default: 10" << std::endl;
+  std::cout << "  --sensors COUNT             Number of sensors. Default: 10" << std::endl;
+  std::cout << "  --latency MS                Time to wait before answering a request. Default: 0" << std::endl;
+  std::cout << "  --jitter MS                 Maximum random deviation from the latency. Default: 0" << std::endl;
+  std::cout << "  --light-rate RATE           Light commands per second. 0 disables the limit. Default: 10" << std::endl;
+  std::cout << "  --group-rate RATE           Group commands per second. 0 disables the limit. Default: 1" << std::endl;
+  std::cout << "  --reject                    Reject commands exceeding the rate with error 901 instead of delaying them." << std::endl;
+  std::cout << "  --padding BYTES             Additional bytes per light to increase the payload size. Default: 0" << std::endl;
+  std::cout << "  --changes RATE              Random light changes per second. Default: 0" << std::endl;
+  std::cout << "  --sensor-events RATE        Random sensor events per second. Default: 0" << std::endl;
+  std::cout << "  --script FILE               Replays the state changes in FILE in a loop. Each line has the format" << std::endl;
+  std::cout << "                              \"<milliseconds> <resource> <json>\", e. g. \"1500 /lights/3/state {\"on\":false}\"." << std::endl;
+  std::cout << "  --idle-timeout MS           Close keep-alive connections idle for MS. Default: 0 (never)" << std::endl;
+  std::cout << "  --max-requests COUNT        Close connections after COUNT requests. Default: 0 (never)" << std::endl;
+  std::cout << "  --link-button-attempts N    Number of user creations failing with \"link button not pressed\". Default: 0" << std::endl;
+  std::cout << "  --user NAME                 Accept the user NAME. Can be specified multiple times." << std::endl;
+  std::cout << "  --strict-users              Only accept users passed with --user or created with \"POST /api\"." << std::endl;
+  std::cout << "  --statistics SECONDS        Print statistics every SECONDS. Default: 0 (never)" << std::endl << std::endl;
+  std::cout << "\"GET /emulator/stats\" returns the counters and \"POST /emulator/reset\" resets them." << std::endl;
+}
+
+bool parseOptions(int argc, char *argv[], Options &options) {
+  for (int32_t i = 1; i < argc; i++) {
+    std::string option(argv[i]);
+    if (option == "--help" || option == "-h") return false;
+    else if (option == "--reject") options.rejectOverLimit = true;
+    else if (option == "--strict-users") options.strictUsers = true;
+    else if (i + 1 >= argc) {
+      std::cerr << "Missing value for " << option << "." << std::endl;
+      return false;
+    } else {
+      std::string value(argv[++i]);
+      if (option == "--port") options.port = std::stoi(value);
+      else if (option == "--lights") options.lights = std::max(0, std::stoi(value));
+      else if (option == "--groups") options.groups = std::max(0, std::stoi(value));
+      else if (option == "--sensors") options.sensors = std::max(0, std::stoi(value));
+      else if (option == "--latency") options.latency = std::max(0, std::stoi(value));
+      else if (option == "--jitter") options.jitter = std::max(0, std::stoi(value));
+      else if (option == "--light-rate") options.lightRate = std::stod(value);
+      else if (option == "--group-rate") options.groupRate = std::stod(value);
+      else if (option == "--padding") options.padding = std::max(0, std::stoi(value));
+      else if (option == "--changes") options.changeRate = std::stod(value);
+      else if (option == "--sensor-events") options.sensorEventRate = std::stod(value);
+      else if (option == "--script") options.script = value;
+      else if (option == "--idle-timeout") options.idleTimeout = std::max(0, std::stoi(value));
+      else if (option == "--max-requests") options.maxRequests = std::max(0, std::stoi(value));
+      else if (option == "--link-button-attempts") options.linkButtonAttempts = std::max(0, std::stoi(value));
+      else if (option == "--user") options.users.push_back(value);
+      else if (option == "--statistics") options.statisticsInterval = std::max(0, std::stoi(value));
+      else {
+        std::cerr << "Unknown option " << option << "." << std::endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+  using namespace HueEmulator;
+
+  Options options;
+  try {
+    if (!parseOptions(argc, argv, options)) {
+      printHelp();
+      return 1;
+    }
+  }
+  catch (const std::exception &ex) {
+    std::cerr << "Invalid option value: " << ex.what() << std::endl;
+    return 1;
+  }
+
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, [](int) { stop = true; });
+  signal(SIGTERM, [](int) { stop = true; });
+
+  Statistics statistics;
+  Bridge bridge(options, statistics);
+  Script script;
+  if (!options.script.empty() && !script.load(options.script)) {
+    std::cerr << "Could not load script " << options.script << "." << std::endl;
+    return 1;
+  }
+
+  Server server(options, bridge, statistics);
+  if (!server.start()) {
+    std::cerr << "Could not listen on port " << options.port << ": " << std::strerror(errno) << std::endl;
+    return 1;
+  }
+  std::cout << "Emulating a hue bridge with " << options.lights << " lights, " << options.groups << " groups and " << options.sensors << " sensors on 127.0.0.1:" << options.port << "." << std::endl;
+
+  std::thread changeThread([&]() {
+    double pendingChanges = 0;
+    double pendingSensorEvents = 0;
+    int64_t lastTime = getTime();
+    int64_t lastStatistics = lastTime;
+    int64_t lastRequests = 0;
+    int64_t lastCommands = 0;
+    int64_t lastPolls = 0;
+    while (!stop) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      int64_t time = getTime();
+      pendingChanges += options.changeRate * (double)(time - lastTime) / 1000.0;
+      pendingSensorEvents += options.sensorEventRate * (double)(time - lastTime) / 1000.0;
+      lastTime = time;
+      for (; pendingChanges >= 1.0; pendingChanges -= 1.0) {
+        bridge.changeRandomLight();
+      }
+      for (; pendingSensorEvents >= 1.0; pendingSensorEvents -= 1.0) {
+        bridge.triggerRandomSensor();
+      }
+      script.run(bridge, statistics);
+
+      if (options.statisticsInterval > 0 && time - lastStatistics >= options.statisticsInterval * 1000) {
+        double seconds = (double)(time - lastStatistics) / 1000.0;
+        std::cout << "requests/s: " << (double)(statistics.requests - lastRequests) / seconds << ", commands/s: " << (double)(statistics.commands - lastCommands) / seconds << ", polls/s: " << (double)(statistics.polls - lastPolls) / seconds << ", connections: " << statistics.connections << ", delayed: " << statistics.delayedCommands << ", rejected: " << statistics.rejectedCommands << std::endl;
+        lastStatistics = time;
+        lastRequests = statistics.requests;
+        lastCommands = statistics.commands;
+        lastPolls = statistics.polls;
+      }
+    }
+  });
+
+  server.run();
+  changeThread.join();
+  return 0;
+}
@@ -0,0 +1,385 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+
+/*
+ * Replays recorded light and group payloads through PhilipsHuePeer::packetReceived and prints the time, the number of heap allocations
+ * and the number of events per packet. See "--help" for the options.
+ */
+
+#include "../src/GD.h"
+#include "../src/PhilipsHuePeer.h"
+#include "../src/PhilipsHueDeviceTypes.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+
+namespace {
+std::atomic<uint64_t> allocations{0};
+}
+
+// {{{ Count all heap allocations of the process. The benchmark runs on one thread, so the counter only changes while packets are processed.
+void *operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  void *memory = std::malloc(size == 0 ? 1 : size);
+  if (!memory) throw std::bad_alloc();
+  return memory;
+}
+
+void *operator new[](std::size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void *memory) noexcept {
+  std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept {
+  std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept {
+  std::free(memory);
+}
+
+void operator delete[](void *memory, std::size_t) noexcept {
+  std::free(memory);
+}
+// }}}
+
+namespace PhilipsHue {
+
+/**
+ * A peer without database and central. Events are counted instead of being passed on.
+ */
+class BenchmarkPeer : public PhilipsHuePeer {
+ public:
+  uint64_t events = 0;
+  uint64_t eventValues = 0;
+
+  BenchmarkPeer(int32_t address, const std::string &serialNumber) : PhilipsHuePeer(0, address, serialNumber, 0, nullptr) {}
+
+  void initialize(uint32_t deviceType, const std::shared_ptr<HomegearDevice> &device) {
+    setDeviceType(deviceType);
+    setRpcDevice(device);
+    initializeCentralConfig();
+    initializeConversionMatrix();
+  }
+ protected:
+  void raiseEvent(std::string &source, uint64_t peerId, int32_t channel, std::shared_ptr<std::vector<std::string>> &variables, std::shared_ptr<std::vector<PVariable>> &values) override {
+    events++;
+    eventValues += variables->size();
+  }
+
+  void raiseRPCEvent(std::string &source, uint64_t peerId, int32_t channel, std::string &deviceAddress, std::shared_ptr<std::vector<std::string>> &valueKeys, std::shared_ptr<std::vector<PVariable>> &values) override {
+  }
+};
+
+struct Resource {
+  std::shared_ptr<BenchmarkPeer> peer;
+  std::shared_ptr<PhilipsHuePacket> recordedPacket;
+  std::shared_ptr<PhilipsHuePacket> modifiedPacket; //Differs from the recorded packet in every value the peer raises events for
+};
+
+struct Result {
+  std::string name;
+  uint64_t packets = 0;
+  double nanosecondsPerPacket = 0;
+  double allocationsPerPacket = 0;
+  double eventsPerPacket = 0;
+  double valuesPerPacket = 0;
+};
+
+struct Options {
+  std::string deviceDirectory = "misc/Device Description Files";
+  std::string lightsFile = "tools/benchmark-data/lights.json";
+  std::string groupsFile = "tools/benchmark-data/groups.json";
+  int32_t iterations = 1000;
+  std::string baselineFile;
+  std::string saveBaselineFile;
+};
+
+std::string readFile(const std::string &filename) {
+  std::ifstream file(filename);
+  std::stringstream stream;
+  stream << file.rdbuf();
+  return stream.str();
+}
+
+void setInteger(const PVariable &json, const std::string &key, int32_t value) {
+  auto iterator = json->structValue->find(key);
+  if (iterator != json->structValue->end()) iterator->second = std::make_shared<BaseLib::Variable>(value);
+}
+
+void toggleBoolean(const PVariable &json, const std::string &key) {
+  auto iterator = json->structValue->find(key);
+  if (iterator != json->structValue->end()) iterator->second = std::make_shared<BaseLib::Variable>(!iterator->second->booleanValue);
+}
+
+/**
+ * Changes brightness, colors and the on state, so every replay of the packet is processed completely.
+ */
+void modify(const PVariable &state) {
+  if (!state || state->type != BaseLib::VariableType::tStruct) return;
+  auto iterator = state->structValue->find("bri");
+  if (iterator != state->structValue->end()) setInteger(state, "bri", (iterator->second->integerValue % 254) + 1);
+  iterator = state->structValue->find("hue");
+  if (iterator != state->structValue->end()) setInteger(state, "hue", (iterator->second->integerValue + 1000) % 65536);
+  iterator = state->structValue->find("sat");
+  if (iterator != state->structValue->end()) setInteger(state, "sat", (iterator->second->integerValue + 10) % 255);
+  iterator = state->structValue->find("ct");
+  if (iterator != state->structValue->end()) setInteger(state, "ct", iterator->second->integerValue == 500 ? 153 : iterator->second->integerValue + 1);
+  iterator = state->structValue->find("xy");
+  if (iterator != state->structValue->end() && iterator->second->arrayValue->size() == 2) {
+    auto xy = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tArray);
+    xy->arrayValue->push_back(std::make_shared<BaseLib::Variable>(1.0 - iterator->second->arrayValue->at(0)->floatValue));
+    xy->arrayValue->push_back(std::make_shared<BaseLib::Variable>(1.0 - iterator->second->arrayValue->at(1)->floatValue));
+    iterator->second = xy;
+  }
+  toggleBoolean(state, "on");
+  toggleBoolean(state, "any_on");
+  toggleBoolean(state, "all_on");
+}
+
+/**
+ * Creates one peer per light or group in a recorded response of "GET /api/<username>/lights" or "GET /api/<username>/groups".
+ */
+bool loadResources(const std::string &filename, PhilipsHuePacket::Category category, const std::map<std::string, std::shared_ptr<HomegearDevice>> &devices, std::vector<Resource> &resources) {
+  std::string json = readFile(filename);
+  if (json.empty()) {
+    std::cerr << "Could not read " << filename << "." << std::endl;
+    return false;
+  }
+  BaseLib::Rpc::JsonDecoder decoder(GD::bl);
+  PVariable recorded = decoder.decode(json);
+  PVariable modified = decoder.decode(json);
+  if (!recorded || recorded->type != BaseLib::VariableType::tStruct) {
+    std::cerr << filename << " does not contain a JSON object." << std::endl;
+    return false;
+  }
+
+  for (auto &element : *recorded->structValue) {
+    int32_t address = BaseLib::Math::getNumber(element.first);
+    std::shared_ptr<BenchmarkPeer> peer;
+    if (category == PhilipsHuePacket::Category::group) {
+      std::string serialNumber = "*HUE";
+      std::string addressString = BaseLib::HelperFunctions::getHexString(address);
+      serialNumber.resize(12 - addressString.size(), '0');
+      serialNumber.append(addressString);
+      peer = std::make_shared<BenchmarkPeer>(address, serialNumber);
+      peer->initialize(0x1000, devices.at("Group.xml"));
+    } else {
+      auto modelIdIterator = element.second->structValue->find("modelid");
+      std::string modelId = modelIdIterator == element.second->structValue->end() ? "" : modelIdIterator->second->stringValue;
+      peer = std::make_shared<BenchmarkPeer>(address, "BENCH" + std::to_string(address));
+      if (modelId.compare(0, 3, "LWB") == 0) peer->initialize((uint32_t)DeviceType::LWB004, devices.at("LWB.xml"));
+      else peer->initialize((uint32_t)DeviceType::LCT001, devices.at("LCT.xml"));
+    }
+
+    auto modifiedJson = modified->structValue->at(element.first);
+    modify(modifiedJson->structValue->find("state") == modifiedJson->structValue->end() ? nullptr : modifiedJson->structValue->at("state"));
+    if (modifiedJson->structValue->find("action") != modifiedJson->structValue->end()) modify(modifiedJson->structValue->at("action"));
+
+    Resource resource;
+    resource.peer = peer;
+    uint8_t messageType = category == PhilipsHuePacket::Category::group ? 0x80 : 1;
+    resource.recordedPacket = std::make_shared<PhilipsHuePacket>(category, address, 0, messageType, element.second);
+    resource.modifiedPacket = std::make_shared<PhilipsHuePacket>(category, address, 0, messageType, modifiedJson);
+    resources.push_back(resource);
+  }
+  return true;
+}
+
+/**
+ * Replays the packets of all resources "iterations" times.
+ *
+ * @param changing When "true", recorded and modified packets alternate, so all values change with every packet. Otherwise the
+ * recorded packets are replayed and nothing changes after the first replay (which is not measured).
+ */
+Result run(const std::string &name, std::vector<Resource> &resources, int32_t iterations, bool changing) {
+  Result result;
+  result.name = name;
+  for (auto &resource : resources) {
+    resource.peer->packetReceived(resource.recordedPacket);
+    resource.peer->events = 0;
+    resource.peer->eventValues = 0;
+  }
+
+  uint64_t startAllocations = allocations;
+  auto startTime = std::chrono::steady_clock::now();
+  for (int32_t i = 0; i < iterations; i++) {
+    bool modified = changing && (i % 2 == 0);
+    for (auto &resource : resources) {
+      resource.peer->packetReceived(modified ? resource.modifiedPacket : resource.recordedPacket);
+    }
+  }
+  auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+  uint64_t packetAllocations = allocations - startAllocations;
+
+  uint64_t events = 0;
+  uint64_t eventValues = 0;
+  for (auto &resource : resources) {
+    events += resource.peer->events;
+    eventValues += resource.peer->eventValues;
+  }
+  result.packets = (uint64_t)iterations * resources.size();
+  if (result.packets == 0) return result;
+  result.nanosecondsPerPacket = (double)duration / (double)result.packets;
+  result.allocationsPerPacket = (double)packetAllocations / (double)result.packets;
+  result.eventsPerPacket = (double)events / (double)result.packets;
+  result.valuesPerPacket = (double)eventValues / (double)result.packets;
+  return result;
+}
+
+std::map<std::string, Result> loadBaseline(const std::string &filename) {
+  std::map<std::string, Result> baseline;
+  std::ifstream file(filename);
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line.front() == '#') continue;
+    std::stringstream stream(line);
+    Result result;
+    if (stream >> result.name >> result.packets >> result.nanosecondsPerPacket >> result.allocationsPerPacket >> result.eventsPerPacket >> result.valuesPerPacket) baseline[result.name] = result;
+  }
+  return baseline;
+}
+
+bool saveBaseline(const std::string &filename, const std::vector<Result> &results) {
+  std::ofstream file(filename);
+  if (!file) return false;
+  file << "# name packets ns/packet allocations/packet events/packet values/packet" << std::endl;
+  for (auto &result : results) {
+    file << result.name << ' ' << result.packets << ' ' << result.nanosecondsPerPacket << ' ' << result.allocationsPerPacket << ' ' << result.eventsPerPacket << ' ' << result.valuesPerPacket << std::endl;
+  }
+  return true;
+}
+
+std::string getChange(double value, double baselineValue) {
+  if (baselineValue == 0) return "";
+  std::ostringstream stream;
+  stream << std::showpos << std::fixed << std::setprecision(1) << ((value - baselineValue) * 100.0 / baselineValue) << " %";
+  return stream.str();
+}
+
+void printResults(const std::vector<Result> &results, const std::map<std::string, Result> &baseline) {
+  std::cout << std::left << std::setw(18) << "Benchmark" << std::right << std::setw(10) << "Packets" << std::setw(14) << "ns/packet" << std::setw(14) << "allocs/packet" << std::setw(14) << "events/packet" << std::setw(14) << "values/packet";
+  if (!baseline.empty()) std::cout << std::setw(14) << "ns change" << std::setw(14) << "allocs change";
+  std::cout << std::endl;
+  for (auto &result : results) {
+    std::cout << std::left << std::setw(18) << result.name << std::right << std::setw(10) << result.packets << std::fixed << std::setprecision(1) << std::setw(14) << result.nanosecondsPerPacket << std::setw(14) << result.allocationsPerPacket << std::setprecision(2) << std::setw(14) << result.eventsPerPacket << std::setw(14) << result.valuesPerPacket;
+    auto baselineIterator = baseline.find(result.name);
+    if (baselineIterator != baseline.end()) {
+      std::cout << std::setw(14) << getChange(result.nanosecondsPerPacket, baselineIterator->second.nanosecondsPerPacket) << std::setw(14) << getChange(result.allocationsPerPacket, baselineIterator->second.allocationsPerPacket);
+      //Optimizations must not change what consumers receive.
+      if (baselineIterator->second.eventsPerPacket != result.eventsPerPacket || baselineIterator->second.valuesPerPacket != result.valuesPerPacket) std::cout << "  (events differ from baseline)";
+    }
+    std::cout << std::endl;
+  }
+}
+
+void printHelp() {
+  std::cout << "Usage: packet-benchmark [OPTIONS]" << std::endl << std::endl;
+  std::cout << "Replays recorded light and group payloads through the packet pipeline of the peers." << std::endl << std::endl;
+  std::cout << "Options:" << std::endl;
+  std::cout << "  --devices DIRECTORY     Directory containing LCT.xml, LWB.xml and Group.xml. Default: misc/Device Description Files" << std::endl;
+  std::cout << "  --lights FILE           Recorded response of \"GET /api/<username>/lights\". Default: tools/benchmark-data/lights.json" << std::endl;
+  std::cout << "  --groups FILE           Recorded response of \"GET /api/<username>/groups\". Default: tools/benchmark-data/groups.json" << std::endl;
+  std::cout << "  --iterations COUNT      Number of replays of all payloads per benchmark. Default: 1000" << std::endl;
+  std::cout << "  --baseline FILE         Compare the results with a baseline saved before." << std::endl;
+  std::cout << "  --save-baseline FILE    Save the results as baseline." << std::endl;
+}
+
+bool parseOptions(int argc, char *argv[], Options &options) {
+  for (int32_t i = 1; i < argc; i++) {
+    std::string option(argv[i]);
+    if (option == "--help" || option == "-h" || i + 1 >= argc) return false;
+    std::string value(argv[++i]);
+    if (option == "--devices") options.deviceDirectory = value;
+    else if (option == "--lights") options.lightsFile = value;
+    else if (option == "--groups") options.groupsFile = value;
+    else if (option == "--iterations") options.iterations = std::max(1, BaseLib::Math::getNumber(value));
+    else if (option == "--baseline") options.baselineFile = value;
+    else if (option == "--save-baseline") options.saveBaselineFile = value;
+    else return false;
+  }
+  return true;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+  using namespace PhilipsHue;
+
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    printHelp();
+    return 1;
+  }
+
+  BaseLib::SharedObjects bl;
+  bl.debugLevel = 2;
+  GD::bl = &bl;
+  GD::out.init(&bl);
+  GD::out.setPrefix("Packet benchmark: ");
+
+  std::map<std::string, std::shared_ptr<HomegearDevice>> devices;
+  for (const std::string filename : {"LCT.xml", "LWB.xml", "Group.xml"}) {
+    bool oldFormat = false;
+    devices.emplace(filename, std::make_shared<HomegearDevice>(&bl, options.deviceDirectory + "/" + filename, oldFormat));
+  }
+
+  std::vector<Resource> lights;
+  std::vector<Resource> groups;
+  if (!loadResources(options.lightsFile, PhilipsHuePacket::Category::light, devices, lights)) return 1;
+  if (!loadResources(options.groupsFile, PhilipsHuePacket::Category::group, devices, groups)) return 1;
+
+  std::vector<Result> results;
+  results.push_back(run("lights/changing", lights, options.iterations, true));
+  results.push_back(run("lights/unchanged", lights, options.iterations, false));
+  results.push_back(run("groups/changing", groups, options.iterations, true));
+  results.push_back(run("groups/unchanged", groups, options.iterations, false));
+
+  std::map<std::string, Result> baseline;
+  if (!options.baselineFile.empty()) {
+    baseline = loadBaseline(options.baselineFile);
+    if (baseline.empty()) std::cerr << "Baseline " << options.baselineFile << " is empty or could not be read." << std::endl;
+  }
+  printResults(results, baseline);
+
+  if (!options.saveBaselineFile.empty() && !saveBaseline(options.saveBaselineFile, results)) {
+    std::cerr << "Could not save baseline to " << options.saveBaselineFile << "." << std::endl;
+    return 1;
+  }
+  return 0;
+}